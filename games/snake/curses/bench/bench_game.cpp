@@ -0,0 +1,187 @@
+#include <benchmark/benchmark.h>
+#include "game.h"
+#include "render.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+static const uint64_t SEED = 12345;
+
+// Cell order of a Hamiltonian cycle on an even-height board: right along row 0 from
+// column 1, serpentine down through columns 1.., then back up column 0.
+static std::vector<Point> cycleOrder(int width, int height) {
+    std::vector<Point> order;
+    order.reserve((size_t)width * height);
+    for (int y = 0; y < height; ++y) {
+        if (y % 2 == 0) {
+            for (int x = 1; x < width; ++x) order.push_back({x, y});
+        } else {
+            for (int x = width - 1; x >= 1; --x) order.push_back({x, y});
+        }
+    }
+    for (int y = height - 1; y >= 0; --y) order.push_back({0, y});
+    return order;
+}
+
+// A snake of the given length laid along the cycle, so steering it with next() never
+// kills it no matter how long the benchmark runs
+struct CycleGame {
+    int width, height, length;
+    std::vector<Point> order;
+    std::vector<int> pos;
+    Game game;
+    int restarts = 0;
+
+    CycleGame(int width, int height, int length)
+        : width(width), height(height), length(length), order(cycleOrder(width, height)), pos((size_t)width * height),
+          game(makeGame(width, height, length)) {
+        for (size_t i = 0; i < order.size(); ++i) pos[order[i].y * width + order[i].x] = (int)i;
+    }
+
+    Game makeGame(int width, int height, int length) {
+        std::vector<Point> snake;
+        for (int i = length - 1; i >= 0; --i) snake.push_back(order[i]);
+        Point food = order[(length + order.size()) / 2];
+        Game g(width, height, 1, snake, food);
+        g.reseed(SEED);
+        return g;
+    }
+
+    // Every food eaten makes the snake longer, so once it has grown the game starts over
+    // (untimed) and a run keeps measuring the length it was given. True if it restarted.
+    bool holdLength(benchmark::State& state) {
+        if (game.getSnake().size() <= (size_t)length) return false;
+        state.PauseTiming();
+        game = makeGame(width, height, length);
+        restarts++;
+        state.ResumeTiming();
+        return true;
+    }
+
+    void next() {
+        Point head = game.getSnake().front();
+        const Point& to = order[(pos[head.y * width + head.x] + 1) % order.size()];
+        if (to.x > head.x) game.setDirection(RIGHT);
+        else if (to.x < head.x) game.setDirection(LEFT);
+        else game.setDirection(to.y > head.y ? DOWN : UP);
+    }
+};
+
+// Board sizes from the default terminal up to 1000x1000, each with a short, a quarter-board
+// and a nearly full snake
+static void boardArgs(benchmark::internal::Benchmark* b) {
+    const int sizes[][2] = {{40, 20}, {200, 100}, {1000, 1000}};
+    for (const auto& s : sizes) {
+        int cells = s[0] * s[1];
+        for (int length : {3, cells / 4, cells * 9 / 10}) b->Args({s[0], s[1], length});
+    }
+}
+
+static void BM_GameStep(benchmark::State& state) {
+    CycleGame cg((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    for (auto _ : state) {
+        cg.holdLength(state);
+        cg.next();
+        cg.game.step();
+    }
+    state.counters["restarts"] = cg.restarts;
+}
+BENCHMARK(BM_GameStep)->Apply(boardArgs);
+
+static void BM_RandomFood(benchmark::State& state) {
+    CycleGame cg((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    for (auto _ : state) benchmark::DoNotOptimize(cg.game.randomFood());
+}
+BENCHMARK(BM_RandomFood)->Apply(boardArgs);
+
+static void BM_ComputeTickMs(benchmark::State& state) {
+    CycleGame cg((int)state.range(0), (int)state.range(1), 3);
+    for (auto _ : state) benchmark::DoNotOptimize(cg.game.computeTickMs());
+}
+BENCHMARK(BM_ComputeTickMs)->Args({40, 20})->Args({200, 100})->Args({1000, 1000});
+
+// 1001x1001 level with several foods out. Everything but a ring just inside the border is
+// an obstacle, so every food spawns on the ring the snake laps: the driver stays trivial
+// while it keeps eating, growing and respawning foods, starting over when the ring is full.
+static void BM_LevelStep(benchmark::State& state) {
+    int size = (int)state.range(0);
+    auto on_ring = [&](int x, int y) {
+        return ((x == 1 || x == size - 2) && y >= 1 && y <= size - 2) || ((y == 1 || y == size - 2) && x >= 1 && x <= size - 2);
+    };
+    Level level;
+    level.width = size;
+    level.height = size;
+    level.food_count = (int)state.range(1);
+    level.start = {3, 1};
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (!on_ring(x, y)) level.obstacles.push_back(y * size + x);
+        }
+    }
+    Game game(level, 1, SEED);
+    int resets = 0;
+    int64_t eaten = 0;
+    size_t longest = 0;
+    for (auto _ : state) {
+        Point head = game.getSnake().front();
+        if (head.y == 1 && head.x < size - 2) game.setDirection(RIGHT);
+        else if (head.x == size - 2 && head.y < size - 2) game.setDirection(DOWN);
+        else if (head.y == size - 2 && head.x > 1) game.setDirection(LEFT);
+        else game.setDirection(UP);
+        size_t length = game.getSnake().size();
+        game.step();
+        if (game.getSnake().size() > length) eaten++;
+        // A full ring has no room left for food, start over rather than lap with nothing to eat
+        if (game.isGameOver() || game.getFood().x < 0) {
+            state.PauseTiming();
+            longest = std::max(longest, game.getSnake().size());
+            game.reset();
+            resets++;
+            state.ResumeTiming();
+        }
+    }
+    state.counters["obstacles"] = (double)level.obstacles.size();
+    state.counters["eaten"] = (double)eaten;
+    state.counters["longest"] = (double)std::max(longest, game.getSnake().size());
+    state.counters["resets"] = resets;
+}
+BENCHMARK(BM_LevelStep)->Args({1001, 1})->Args({1001, 64});
+
+// Steady-state delta frame: the step runs outside the timed region
+static void BM_RendererDraw(benchmark::State& state) {
+    CycleGame cg((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    Renderer renderer(cg.game.getBoard().getWidth(), cg.game.getBoard().getHeight(), -1);
+    renderer.draw(cg.game);
+    size_t bytes = 0;
+    for (auto _ : state) {
+        // A restarted game is a different board, redrawn outside the measured time
+        if (cg.holdLength(state)) renderer.draw(cg.game);
+        cg.next();
+        cg.game.step();
+        auto start = std::chrono::steady_clock::now();
+        renderer.draw(cg.game);
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        bytes += renderer.getLastFrameBytes();
+    }
+    state.counters["bytes_per_frame"] = benchmark::Counter((double)bytes / state.iterations());
+    state.counters["restarts"] = cg.restarts;
+}
+BENCHMARK(BM_RendererDraw)->Apply(boardArgs)->UseManualTime();
+
+// Full redraw, as after a resize: the border is drawn outside the timed region
+static void BM_RendererDrawFull(benchmark::State& state) {
+    CycleGame cg((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    int width = cg.game.getBoard().getWidth();
+    int height = cg.game.getBoard().getHeight();
+    Renderer renderer(width, height, -1);
+    for (auto _ : state) {
+        renderer.resize(width, height);
+        auto start = std::chrono::steady_clock::now();
+        renderer.draw(cg.game);
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    state.counters["bytes_per_frame"] = (double)renderer.getLastFrameBytes();
+}
+BENCHMARK(BM_RendererDrawFull)->Apply(boardArgs)->UseManualTime();
+
+BENCHMARK_MAIN();
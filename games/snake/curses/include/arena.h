@@ -0,0 +1,80 @@
+#pragma once
+
+#include "game.h"
+#include "board.h"
+#include "rng.h"
+#include "snake_body.h"
+#include <cstdint>
+#include <vector>
+
+// A cell that changed during the last arena tick. owner is the snake id for heads, -1 otherwise.
+struct ArenaChange {
+    uint32_t cell;
+    CellKind kind;
+    int32_t owner;
+};
+
+// Many snakes on one board, advanced together by an authoritative tick. Collisions are
+// looked up in the shared occupancy grid, so a tick costs O(snakes) however long they are.
+//
+// Rules match Game::step per snake. All moves are resolved against the board as it was at
+// the start of the tick (after tails moved on), so the outcome doesn't depend on snake
+// order: two heads entering the same cell both die, as does a head entering a body that
+// dies in the same tick. Dead snakes leave the board and respawn on a later tick.
+class Arena {
+public:
+    struct Snake {
+        SnakeBody body;
+        Direction dir = RIGHT;
+        Direction wanted = RIGHT;
+        bool active = false; // slot in use
+        bool alive = false;  // on the board
+        int score = 0;
+    };
+
+    Arena(int width, int height, int food_count, uint64_t seed);
+
+    // Takes a free slot and returns its id, the snake spawns on the next tick with room
+    int join();
+    // The snake's cells are emptied right away and reported with the next tick's changes
+    void leave(int id);
+    // Applied on the next tick, reversing onto the body is ignored
+    void setDirection(int id, Direction dir);
+    void step();
+
+    const std::vector<ArenaChange>& getChanges() const;
+    // Ids that died during the last tick
+    const std::vector<int>& getDeaths() const;
+    const std::vector<Snake>& getSnakes() const;
+    const std::vector<int32_t>& getFood() const;
+    const Board& getBoard() const;
+    uint64_t getTicks() const;
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    bool spawn(int id);
+    void kill(int id);
+    void placeFood(size_t slot);
+
+    int width, height;
+    Board board;
+    Rng rng;
+    uint64_t ticks;
+    std::vector<Snake> snakes;
+    std::vector<int> free_ids;
+    // Food cells, and for every cell the food slot on it or -1
+    std::vector<int32_t> food;
+    std::vector<int32_t> food_at;
+
+    // Per tick scratch, indexed by snake id or cell
+    std::vector<int32_t> next_head;
+    std::vector<uint8_t> dying;
+    std::vector<uint64_t> claim_tick;
+    std::vector<int32_t> claim_id;
+    std::vector<int32_t> eaten;
+    std::vector<ArenaChange> changes;
+    // How many of changes the last step produced, the rest were queued after it
+    size_t tick_changes = 0;
+    std::vector<int> deaths;
+};
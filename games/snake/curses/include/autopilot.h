@@ -0,0 +1,53 @@
+#pragma once
+
+#include "game.h"
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Picks a direction each tick: a path to the food when the snake can still escape from the
+// first step of it, otherwise any escapable move, preferring the order of a Hamiltonian cycle
+// of the board. "Escape" means reaching a body cell by the time the tail has vacated it, so
+// searches account for the body moving. Search buffers are sized once per board size.
+class Autopilot {
+public:
+    explicit Autopilot(std::chrono::microseconds budget = std::chrono::microseconds(1000));
+
+    Direction choose(const Game& game);
+
+private:
+    void ensureSize(int width, int height);
+    void buildCycle();
+    void trackBody(const Game& game);
+    bool passable(const Board& board, int cell, int arrival) const;
+    // A* from start towards goal. Returns goal, or with escape set any body cell reached after
+    // it has been vacated, filling parent. Returns -1 if nothing is reachable or out of budget.
+    int search(const Board& board, int start, int start_dist, int goal, bool escape);
+    Direction towards(int from, int to) const;
+    bool deadlineHit() const;
+
+    std::chrono::microseconds budget;
+    std::chrono::steady_clock::time_point deadline;
+    bool out_of_time;
+
+    int width, height;
+    std::vector<int32_t> parent;
+    std::vector<int32_t> dist;
+    std::vector<uint32_t> seen;
+    std::vector<int32_t> queue;
+    std::vector<int32_t> next;
+    // Position of each cell along the Hamiltonian cycle, empty when the board has none
+    std::vector<int32_t> cycle_pos;
+    uint32_t stamp;
+
+    // Tick at which the head entered each body cell, kept up to date incrementally
+    std::vector<int64_t> entered;
+    uint64_t last_ticks;
+    int last_head;
+    int tail;
+    // Extra ticks the tail stays put, 1 while searching from a move that eats
+    int delay;
+    // (distance, cell) of every food this tick
+    std::vector<std::pair<int, int>> targets;
+};
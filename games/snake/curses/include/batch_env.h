@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// Batched snake environment for agents: steps many boards at once using the same rules
+// as Game::step. State is stored struct-of-arrays and batches are sharded across threads.
+//
+// Actions per board: 0 = up, 1 = down, 2 = left, 3 = right (the Direction values),
+// anything else keeps the current direction. Turning back onto the body is ignored.
+// Rewards: +1 for eating, -1 for dying, 0 otherwise. A board that reports done has
+// already been reset and its next step starts a fresh game.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SnakeBatch SnakeBatch;
+
+// threads <= 0 picks the hardware concurrency
+SnakeBatch* snake_batch_create(int batch, int width, int height, uint64_t seed, int threads);
+void snake_batch_destroy(SnakeBatch* env);
+
+void snake_batch_reset(SnakeBatch* env);
+void snake_batch_step(SnakeBatch* env, const int8_t* actions, float* rewards, uint8_t* done);
+
+int snake_batch_size(const SnakeBatch* env);
+// batch planes of width*height bytes, 1 where a snake body cell is
+const uint8_t* snake_batch_occupancy(const SnakeBatch* env);
+// Cell index (y * width + x) of each board's head and food, food is -1 on a full board
+const int32_t* snake_batch_heads(const SnakeBatch* env);
+const int32_t* snake_batch_food(const SnakeBatch* env);
+const int32_t* snake_batch_scores(const SnakeBatch* env);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "rng.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Tracks which board cells are free so collision tests and picking a random free
+// cell are O(1). occupied is a bitboard, one bit per cell in 64-bit words indexed by
+// y * width + x, freeCells is a dense list of free cell indices and freePos maps a cell
+// index to its slot in freeCells (-1 if occupied). Obstacles are simply cells that stay
+// occupied.
+//
+// Boards above DENSE_MAX_CELLS are huge worlds and switch to chunked storage instead:
+// 64x64 tiles of occupancy bits, allocated when a cell in them is occupied and freed
+// when they empty again, so memory follows the occupied area rather than the world.
+// Free cells are then found by rejection sampling, which a mostly empty world makes cheap.
+class Board {
+public:
+    static const int DENSE_MAX_CELLS = 1 << 22;
+
+    Board(int width, int height);
+
+    void resize(int width, int height);
+    // Becomes a copy of other, reusing this board's storage where it can
+    void copyFrom(const Board& other);
+    void occupy(int x, int y);
+    void vacate(int x, int y);
+
+    bool inBounds(int x, int y) const;
+    bool isFree(int x, int y) const;
+    bool isFreeCell(int cell) const;
+    int freeCount() const;
+    // Index into the free list, r must be in [0, freeCount()). Dense boards only.
+    int freeCellAt(int r) const;
+    // Uniformly chosen free cell index, -1 if the board is full
+    int randomFreeCell(Rng& rng) const;
+    bool isChunked() const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    static const int TILE_SHIFT = 6;
+    static const int TILE_MASK = (1 << TILE_SHIFT) - 1;
+
+    int width, height;
+    std::vector<uint64_t> occupied;
+    std::vector<int> freeCells;
+    std::vector<int> freePos;
+
+    // Chunked mode: one row of 64 bits per tile line, plus a count to know when to free it
+    bool chunked;
+    int tilesX;
+    int occupiedCount;
+    std::vector<std::unique_ptr<uint64_t[]>> tiles;
+    std::vector<uint16_t> tileCounts;
+};
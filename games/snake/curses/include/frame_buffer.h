@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Byte buffer a frame is assembled into before it is handed to the terminal in one write
+class FrameBuffer {
+public:
+    explicit FrameBuffer(size_t capacity = 64 * 1024);
+
+    void append(const char* s, size_t n);
+    void append(const char* s);
+    void appendInt(int v);
+    void moveCursor(int row, int col);
+
+    // Writes the whole buffer to fd and empties it, returns the number of bytes written
+    size_t flush(int fd);
+    void clear();
+    size_t size() const;
+    const char* data() const;
+
+private:
+    std::vector<char> buf;
+    size_t len;
+};
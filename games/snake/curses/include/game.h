@@ -1,17 +1,21 @@
 #pragma once
 
-#include <deque>
 #include <string>
 #include <vector>
-#include <chrono>
 #include "input.h"
+#include "board.h"
+#include "rng.h"
+#include "point.h"
+#include "snake_body.h"
+#include "level.h"
+#include <cstdint>
 
-struct Point {
-    int x = 0;
-    int y = 0;
-    Point(int x, int y) : x(x), y(y) {}
-    Point() = default;
-    bool operator==(const Point &o) const { return x == o.x && y == o.y; }
+enum class CellKind { EMPTY, HEAD, BODY, FOOD };
+
+// A cell whose contents changed during the last tick
+struct CellChange {
+    Point p;
+    CellKind kind;
 };
 
 struct Difficulty {
@@ -26,41 +30,96 @@ extern const std::vector<Difficulty> DIFFICULTIES;
 class Game {
 public:
     Game(int width, int height, int diffIndex);
+    // Headless game: food placement is fully determined by seed and no highscore file is read
+    Game(int width, int height, int diffIndex, uint64_t seed);
     // Constructor for testing
-    Game(int width, int height, int diffIndex, std::deque<Point> initial_snake, Point initial_food);
+    Game(int width, int height, int diffIndex, const std::vector<Point>& initial_snake, Point initial_food);
+    // Play on a level's layout instead of an empty board, otherwise like the two above
+    Game(const Level& level, int diffIndex);
+    Game(const Level& level, int diffIndex, uint64_t seed);
 
+    // Applies pause and quit at once and queues turns, which step() takes one per tick
     void processInput(Input* input);
-    void update();
+    // Advances the snake by exactly one tick without sleeping, the caller decides when ticks happen
+    void step();
+    void reset();
+    // Restarts the food sequence from seed, the next reset() then plays like a fresh Game with it
+    void reseed(uint64_t new_seed);
     void resize(int& new_width, int& new_height);
 
     bool isGameOver() const;
     bool isPaused() const;
     int getScore() const;
     int getHighscore() const;
-    const std::deque<Point>& getSnake() const;
+    int getDifficulty() const;
+    uint64_t getSeed() const;
+    // Number of ticks advanced since the last reset
+    uint64_t getTicks() const;
+    const SnakeBody& getSnake() const;
+    // The first food, {-1, -1} if there is none; levels can have several
     const Point& getFood() const;
+    const std::vector<Point>& getFoods() const;
+    // nullptr when playing on an empty board
+    const Level* getLevel() const;
+    bool isObstacle(int x, int y) const;
+    bool isPortal(int x, int y) const;
+    const std::vector<CellChange>& getChanges() const;
+    const Board& getBoard() const;
     Direction getDirection() const;
+    // The direction the next step() will move in, after taking a queued turn if there is one
+    Direction nextDirection() const;
+    // Turns at once and drops queued turns
     void setDirection(Direction new_dir);
+    // Length of the current tick in milliseconds, shrinks as the score grows
+    int computeTickMs() const;
+    // Width the speed is tuned to, the visible window for worlds larger than the screen.
+    // 0 uses the board width.
+    void setPaceWidth(int width);
+    // Uniform pick among the free cells without food, {-1, -1} once there are none
+    Point randomFood();
 
 private:
-    void reset();
-    Point randomFood();
-    int computeTickMs();
+    static const int MAX_TURNS = 3;
+
+    void queueTurn(Direction turn);
+    void takeTurn();
+    Point portalExit(const Point& entry) const;
+    int foodAt(const Point& p) const;
+    void setFoodBit(const Point& p, bool on);
 
     int width, height;
+    int pace_width = 0;
     int diffIndex;
     int score;
     int highscore;
     bool alive;
     bool paused;
+    uint64_t ticks;
+    uint64_t seed;
     Direction dir;
-    std::deque<Point> snake;
-    Point food;
-
-    using clock = std::chrono::steady_clock;
-    std::chrono::time_point<clock> next_tick;
+    // Turns typed since the last step, oldest first; ones that reverse or repeat the
+    // current direction are skipped when taken
+    Direction turns[MAX_TURNS];
+    int turn_count = 0;
+    SnakeBody snake;
+    std::vector<Point> foods;
+    Board board;
+    Rng rng;
+    // Level layout, with obstacles, portal cells and foods also kept as bitboards over
+    // y * width + x. Games without a level have a single food and no bitboards.
+    bool has_level = false;
+    Level level;
+    std::vector<uint64_t> obstacle_bits;
+    std::vector<uint64_t> portal_bits;
+    std::vector<uint64_t> food_bits;
+    // The board with only the obstacles and portals on it, copied in on every reset
+    Board level_board{0, 0};
+    std::vector<CellChange> changes;
 };
 
-int promptDifficulty();
+class Terminal;
+
+// Returns the chosen difficulty index, or -1 if SIGINT/SIGTERM arrived while waiting
+int promptDifficulty(Terminal& term);
 int loadHighscore();
 void saveHighscore(int v);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "game_fwd.h"
+#include <cstdint>
 
 enum Direction { UP, DOWN, LEFT, RIGHT };
 
@@ -16,11 +17,40 @@ enum class UserAction {
     CHANGE_DIFFICULTY
 };
 
+// Turns terminal input into actions one byte at a time, so an escape sequence split
+// across reads is still recognised. Arrow keys come as CSI (ESC [ ... A) or, in
+// application cursor mode, SS3 (ESC O A); other sequences are consumed and ignored.
+class KeyDecoder {
+public:
+    // The action completed by this byte, NONE if it completes nothing (yet)
+    UserAction feed(char c);
+
+private:
+    enum class State { GROUND, ESCAPE, CSI, SS3 };
+    State state = State::GROUND;
+};
+
+// Keys read from stdin, decoded and queued in arrival order so several presses between
+// two ticks all count. When the queue is full newer actions are dropped.
 class Input {
 public:
-    UserAction getUserAction(Direction currentDirection);
+    static constexpr int QUEUE_SIZE = 16;
+
+    // Reads every byte waiting on stdin without blocking
+    void readPending();
+    // Decodes bytes as if they had been read from stdin
+    void feed(const char* bytes, int n);
+    // Oldest queued action, NONE once the queue is empty
+    UserAction pop();
+    bool empty() const;
+    void clear();
 
 private:
     bool kbhit();
     int readBytes(char* buf, int n);
+
+    KeyDecoder decoder;
+    UserAction queue[QUEUE_SIZE];
+    int head = 0;
+    int count = 0;
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "point.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A fixed board layout. Text format, one row per line after optional header lines:
+//
+//   ; comment
+//   food 3
+//   ##########
+//   #S.......#
+//   #..a..#..#
+//   #.....#.a#
+//   ##########
+//
+// '#' is an obstacle, 'S' the snake's head (it starts facing right with two body cells
+// to its left), a lowercase letter is a portal that must appear exactly twice, anything
+// else is open floor. Rows may be ragged, the board is as wide as the longest one.
+// A head moving onto a portal comes out of its partner, one step further along.
+struct Level {
+    int width = 0;
+    int height = 0;
+    int food_count = 1;
+    Point start;
+    std::vector<int> obstacles;
+    std::vector<std::pair<int, int>> portals;
+};
+
+bool parseLevel(const std::string& text, Level& level, std::string& error);
+bool loadLevel(const std::string& path, Level& level, std::string& error);
+// Maze carved by a seeded depth-first search, corridors one cell wide and no dead ends
+Level makeMaze(int width, int height, int food_count, uint64_t seed);
@@ -0,0 +1,9 @@
+#pragma once
+
+struct Point {
+    int x = 0;
+    int y = 0;
+    Point(int x, int y) : x(x), y(y) {}
+    Point() = default;
+    bool operator==(const Point &o) const { return x == o.x && y == o.y; }
+};
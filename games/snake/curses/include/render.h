@@ -1,33 +1,73 @@
 #pragma once
 
 #include "game.h"
+#include "frame_buffer.h"
+#include <cstddef>
 #include <string>
-#include <deque>
+#include <unistd.h>
+#include <vector>
 
 class Renderer {
 public:
-    Renderer(int width, int height);
-    void draw(const std::deque<Point>& snake, const Point& food, int score, int highscore);
+    // A negative out_fd still builds and counts every frame but drops it, for measuring
+    // the renderer without a terminal
+    Renderer(int width, int height, int out_fd = STDOUT_FILENO);
+    // Paints the last tick, same as capture() followed by present()
+    void draw(const Game& game);
+    // Queues the cells the last tick changed, call after every step when several ticks
+    // can run between frames
+    void capture(const Game& game);
+    // Paints everything captured since the previous frame in one write
+    void present(const Game& game);
     void drawGameOver(int score);
     void drawPaused();
     void clearMessage();
     void resize(int width, int height);
     void drawBorder();
+    // Wrap frames in DEC 2026 synchronized updates so the terminal presents them atomically
+    void setSyncUpdates(bool enabled);
+    // Text shown right of the score line, repainted with the next frame when it changes
+    void setOverlay(const std::string& text);
+    // Turns the board area into a window onto a larger world that scrolls to keep the
+    // head away from its edges. Only the visible cells are ever drawn.
+    void setWorld(int world_width, int world_height);
+
+    size_t getLastFrameBytes() const;
+    size_t getTotalBytes() const;
+    size_t getFrameCount() const;
 
 private:
-    void moveCursor(int row, int col);
-    void drawCell(const Point& p, const std::string &color);
+    void drawCell(const Point& p, const char* color);
     void clearCell(const Point& p);
-    void drawText(int row, int col, const std::string &s);
-//    void drawBorder();
+    void drawText(int row, int col, const char* s);
+    void drawFull(const Game& game);
+    void drawWindow(const Game& game);
+    bool followHead(const Game& game);
+    void drawChange(const CellChange& c);
+    void beginFrame();
+    void endFrame();
 
     int width;
     int height;
-    std::deque<Point> last_snake;
-    Point last_food;
+    // World mode: world size (0 when the board fits the screen) and the window's top left
+    int world_width;
+    int world_height;
+    int cam_x;
+    int cam_y;
+    bool full_redraw;
+    bool sync_updates;
+    int out_fd;
     int last_score;
     int last_highscore;
+    std::string overlay;
+    bool overlay_dirty;
+    std::vector<CellChange> pending;
+    FrameBuffer frame;
+    size_t last_frame_bytes;
+    size_t total_bytes;
+    size_t frame_count;
     static const int WALL_OFFSET_X = 3;
     static const int WALL_OFFSET_Y = 2;
     static const int CELL_W = 2;
+    static const int OVERLAY_COL = 32;
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "game.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Everything needed to re-simulate a session: the starting parameters plus the ticks at
+// which the direction changed. Encoded as "SNKR", a version byte and LEB128 varints, with
+// each turn packed as (tick delta << 2) | direction. Version 2 adds the level layout, if
+// any, so a recording plays back without the level file; version 1 files still load.
+struct Replay {
+    struct Turn {
+        uint64_t tick;
+        Direction dir;
+    };
+
+    uint64_t seed = 0;
+    int difficulty = 0;
+    int width = 0;
+    int height = 0;
+    uint64_t end_tick = 0;
+    std::vector<Turn> turns;
+    bool has_level = false;
+    Level level;
+};
+
+class ReplayRecorder {
+public:
+    void start(const Game& game);
+    // Call right before every Game::step so the direction in effect for that tick is captured
+    void beforeStep(const Game& game);
+    const Replay& finish(const Game& game);
+
+private:
+    Replay replay;
+    Direction last_dir = RIGHT;
+};
+
+std::string encodeReplay(const Replay& replay);
+bool decodeReplay(const std::string& data, Replay& replay);
+bool saveReplay(const Replay& replay, const std::string& path);
+bool loadReplay(const std::string& path, Replay& replay);
+std::string replayPath();
+
+// Re-simulates a recording as fast as possible, calling on_tick after every step
+Game playReplay(const Replay& replay, const std::function<void(const Game&)>& on_tick = {});
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// PCG32 (XSH RR) generator, small and fast with a seed that fully determines the stream
+class Rng {
+public:
+    static const uint64_t DEFAULT_SEED = 0x853c49e6748fea9bULL;
+
+    explicit Rng(uint64_t seed = DEFAULT_SEED) { reseed(seed); }
+
+    void reseed(uint64_t seed) {
+        state = 0;
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + INC;
+        uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // Uniform value in [0, bound) without modulo bias
+    uint32_t below(uint32_t bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        while (true) {
+            uint32_t r = next();
+            if (r >= threshold) return r % bound;
+        }
+    }
+
+private:
+    static const uint64_t INC = 1442695040888963407ULL;
+    uint64_t state;
+};
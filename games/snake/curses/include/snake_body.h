@@ -0,0 +1,74 @@
+#pragma once
+
+#include "point.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// The snake's cells from head to tail, stored as packed y * width + x indices in a ring
+// buffer. The ring starts at 1K entries and doubles as the snake outgrows it, up to the
+// board area, so moving only allocates on those few growths and a huge world or a board
+// shared by hundreds of snakes doesn't reserve W*H per snake. A scan walks at most two
+// contiguous runs of 4-byte entries.
+class SnakeBody {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Point;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Point;
+
+        const_iterator(const SnakeBody* body, size_t i) : body(body), i(i) {}
+        Point operator*() const { return (*body)[i]; }
+        const_iterator& operator++() {
+            ++i;
+            return *this;
+        }
+        bool operator==(const const_iterator& o) const { return i == o.i; }
+        bool operator!=(const const_iterator& o) const { return i != o.i; }
+
+    private:
+        const SnakeBody* body;
+        size_t i;
+    };
+
+    explicit SnakeBody(int width = 0, int height = 0);
+
+    // Empties the body and sizes the ring for a width x height board
+    void reset(int width, int height);
+    void pushFront(Point p);
+    void popBack();
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    // Packed index of the i-th cell from the head
+    uint32_t cellAt(size_t i) const {
+        size_t j = head + i;
+        if (j >= ring.size()) j -= ring.size();
+        return ring[j];
+    }
+    Point operator[](size_t i) const {
+        uint32_t c = cellAt(i);
+        return {(int)(c % width), (int)(c / width)};
+    }
+    Point front() const { return head_point; }
+    Point back() const { return tail_point; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, len); }
+
+private:
+    static constexpr size_t INITIAL_CAPACITY = 1 << 10;
+    void grow();
+
+    std::vector<uint32_t> ring;
+    size_t capacity;
+    size_t head;
+    size_t len;
+    uint32_t width;
+    // Unpacked copies of the ends, which every tick reads, so a move needs no division
+    Point head_point;
+    Point tail_point;
+};
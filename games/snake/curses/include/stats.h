@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Fixed-bucket log-linear histogram: exact below 8, then 8 buckets per power of two, so a
+// record is a few shifts and an add, and percentiles are within 12.5% of the true value.
+class Histogram {
+public:
+    static const int BUCKETS = 8 + 61 * 8;
+
+    void record(uint64_t v);
+    uint64_t count() const;
+    uint64_t max() const;
+    double mean() const;
+    // Upper bound of the bucket holding the p-th percentile, p in [0, 1]
+    uint64_t percentile(double p) const;
+    // {"count", "mean", "p50", "p90", "p99", "max", "buckets": [[upper, count], ...]}
+    void writeJson(std::ostream& out) const;
+
+private:
+    static int bucketOf(uint64_t v);
+    static uint64_t bucketUpper(int i);
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t largest = 0;
+};
+
+// What the main loop measures per tick, times in nanoseconds
+struct LoopStats {
+    Histogram tick_ns;        // Game::step
+    Histogram render_ns;      // Renderer::draw, including the write
+    Histogram frame_bytes;    // bytes handed to the terminal per frame
+    Histogram jitter_ns;      // how late the tick woke up against its timer deadline
+    Histogram key_to_draw_ns; // from reading a key to flushing the frame that shows it
+
+    // One line of p50/p99 figures for the in-game overlay
+    std::string hudLine() const;
+    bool save(const std::string& path) const;
+};
+
+uint64_t monotonicNs();
@@ -1,7 +1,5 @@
 #pragma once
 
-#include <atomic>
-
 class Terminal {
 public:
     Terminal();
@@ -10,10 +8,14 @@ public:
     void enableRawMode();
     void disableRawMode();
     void getWindowSize(int& width, int& height);
-    static bool isResized();
-    static void setResized(bool value);
+    // Asks the terminal (DECRQM) whether it understands synchronized updates, mode 2026
+    bool supportsSyncUpdates();
+    // SIGWINCH, SIGINT and SIGTERM are blocked and delivered through this signalfd instead
+    int signalFd() const;
+    // Reads one pending signal from signalFd(), returns its number or 0 if none was pending
+    int readSignal();
 
 private:
-    void setupSignalHandlers();
-    static std::atomic<bool> resized;
+    void setupSignals();
+    int signal_fd;
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+// timerfd that fires at absolute CLOCK_MONOTONIC deadlines, so a varying tick length never drifts
+class TickTimer {
+public:
+    TickTimer();
+    ~TickTimer();
+
+    // Arms the timer to fire ms from now
+    void start(int ms);
+    // Arms the timer to fire ms after the previous deadline
+    void schedule(int ms);
+    void stop();
+    // Reads the expiration count so the fd stops polling readable
+    uint64_t consume();
+    // How far the clock is past the current deadline, 0 if it has not been reached yet
+    uint64_t lateNs() const;
+    int fd() const;
+
+private:
+    void arm();
+
+    int timer_fd;
+    timespec deadline;
+};
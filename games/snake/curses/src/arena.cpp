@@ -0,0 +1,217 @@
+#include "arena.h"
+
+static const int DX[4] = {0, 0, -1, 1};
+static const int DY[4] = {-1, 1, 0, 0};
+
+static bool isReverse(Direction a, Direction b) {
+    return (a ^ 1) == b;
+}
+
+Arena::Arena(int width, int height, int food_count, uint64_t seed)
+    : width(width),
+      height(height),
+      board(width, height),
+      rng(seed),
+      ticks(0),
+      food(food_count, -1),
+      food_at((size_t)width * height, -1),
+      claim_tick((size_t)width * height, 0),
+      claim_id((size_t)width * height, -1) {
+    for (size_t i = 0; i < food.size(); ++i) placeFood(i);
+    changes.clear();
+}
+
+int Arena::join() {
+    int id;
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+    } else {
+        id = (int)snakes.size();
+        snakes.emplace_back();
+        next_head.push_back(0);
+        dying.push_back(0);
+    }
+    Snake& s = snakes[id];
+    s.body.reset(width, height);
+    s.active = true;
+    s.alive = false;
+    s.score = 0;
+    return id;
+}
+
+void Arena::leave(int id) {
+    Snake& s = snakes[id];
+    if (!s.active) return;
+    if (s.alive) kill(id);
+    s.active = false;
+    free_ids.push_back(id);
+}
+
+void Arena::setDirection(int id, Direction dir) {
+    snakes[id].wanted = dir;
+}
+
+// Three cells facing right with room behind the head, a few random tries per tick
+bool Arena::spawn(int id) {
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        int cell = board.randomFreeCell(rng);
+        if (cell < 0) return false;
+        int x = cell % width;
+        int y = cell / width;
+        if (x < 2 || x + 1 >= width) continue;
+        bool room = true;
+        for (int i = 0; i < 3 && room; ++i) room = board.isFree(x - i, y) && food_at[cell - i] < 0;
+        if (!room) continue;
+
+        Snake& s = snakes[id];
+        s.body.reset(width, height);
+        for (int i = 2; i >= 0; --i) {
+            s.body.pushFront({x - i, y});
+            board.occupy(x - i, y);
+            changes.push_back({(uint32_t)(cell - i), i == 0 ? CellKind::HEAD : CellKind::BODY, i == 0 ? id : -1});
+        }
+        s.dir = RIGHT;
+        s.wanted = RIGHT;
+        s.alive = true;
+        s.score = 0;
+        return true;
+    }
+    return false;
+}
+
+void Arena::kill(int id) {
+    Snake& s = snakes[id];
+    for (size_t i = 0; i < s.body.size(); ++i) {
+        uint32_t cell = s.body.cellAt(i);
+        board.vacate(cell % width, cell / width);
+        changes.push_back({cell, CellKind::EMPTY, -1});
+    }
+    s.body.reset(width, height);
+    s.alive = false;
+}
+
+void Arena::placeFood(size_t slot) {
+    food[slot] = -1;
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        int cell = board.randomFreeCell(rng);
+        if (cell < 0) return;
+        if (food_at[cell] >= 0) continue;
+        food[slot] = cell;
+        food_at[cell] = (int32_t)slot;
+        changes.push_back({(uint32_t)cell, CellKind::FOOD, -1});
+        return;
+    }
+}
+
+void Arena::step() {
+    ticks++;
+    // Only the last tick's own changes have been broadcast; cells freed by leave() since
+    // then are still pending and go out with this tick's
+    changes.erase(changes.begin(), changes.begin() + tick_changes);
+    deaths.clear();
+    int n = (int)snakes.size();
+
+    for (int id = 0; id < n; ++id) {
+        if (snakes[id].active && !snakes[id].alive) spawn(id);
+    }
+    for (size_t slot = 0; slot < food.size(); ++slot) {
+        if (food[slot] < 0) placeFood(slot);
+    }
+
+    // Turn and find every new head
+    for (int id = 0; id < n; ++id) {
+        Snake& s = snakes[id];
+        if (!s.alive) continue;
+        if (!isReverse(s.dir, s.wanted)) s.dir = s.wanted;
+        Point h = s.body.front();
+        int nx = h.x + DX[s.dir];
+        int ny = h.y + DY[s.dir];
+        dying[id] = nx < 0 || nx >= width || ny < 0 || ny >= height;
+        next_head[id] = ny * width + nx;
+    }
+
+    // Tails move on first so following a tail stays legal, as in Game::step
+    for (int id = 0; id < n; ++id) {
+        Snake& s = snakes[id];
+        if (!s.alive || dying[id] || food_at[next_head[id]] >= 0) continue;
+        Point tail = s.body.back();
+        board.vacate(tail.x, tail.y);
+        changes.push_back({(uint32_t)(tail.y * width + tail.x), CellKind::EMPTY, -1});
+        s.body.popBack();
+    }
+
+    // Resolve every head against the same board: bodies first, then heads meeting
+    for (int id = 0; id < n; ++id) {
+        if (!snakes[id].alive || dying[id]) continue;
+        int cell = next_head[id];
+        if (!board.isFreeCell(cell)) {
+            dying[id] = 1;
+        } else if (claim_tick[cell] == ticks) {
+            dying[id] = 1;
+            dying[claim_id[cell]] = 1;
+        } else {
+            claim_tick[cell] = ticks;
+            claim_id[cell] = id;
+        }
+    }
+
+    for (int id = 0; id < n; ++id) {
+        if (snakes[id].alive && dying[id]) {
+            kill(id);
+            deaths.push_back(id);
+        }
+    }
+
+    eaten.clear();
+    for (int id = 0; id < n; ++id) {
+        Snake& s = snakes[id];
+        if (!s.alive) continue;
+        int cell = next_head[id];
+        Point head = {cell % width, cell / width};
+        changes.push_back({s.body.cellAt(0), CellKind::BODY, -1});
+        s.body.pushFront(head);
+        board.occupy(head.x, head.y);
+        changes.push_back({(uint32_t)cell, CellKind::HEAD, id});
+        if (food_at[cell] >= 0) {
+            s.score++;
+            eaten.push_back(food_at[cell]);
+            food_at[cell] = -1;
+        }
+    }
+    // Replaced once every head has moved, so new food can't land under one
+    for (int32_t slot : eaten) placeFood(slot);
+    tick_changes = changes.size();
+}
+
+const std::vector<ArenaChange>& Arena::getChanges() const {
+    return changes;
+}
+
+const std::vector<int>& Arena::getDeaths() const {
+    return deaths;
+}
+
+const std::vector<Arena::Snake>& Arena::getSnakes() const {
+    return snakes;
+}
+
+const std::vector<int32_t>& Arena::getFood() const {
+    return food;
+}
+
+const Board& Arena::getBoard() const {
+    return board;
+}
+
+uint64_t Arena::getTicks() const {
+    return ticks;
+}
+
+int Arena::getWidth() const {
+    return width;
+}
+
+int Arena::getHeight() const {
+    return height;
+}
@@ -0,0 +1,231 @@
+#include "autopilot.h"
+#include <algorithm>
+#include <cstdlib>
+
+using std::vector;
+
+static const int DX[4] = {0, 0, -1, 1};
+static const int DY[4] = {-1, 1, 0, 0};
+static const int64_t NEVER = INT64_MAX / 4;
+
+Autopilot::Autopilot(std::chrono::microseconds budget)
+    : budget(budget),
+      out_of_time(false),
+      width(0),
+      height(0),
+      stamp(0),
+      last_ticks(0),
+      last_head(-1),
+      tail(-1),
+      delay(0) {}
+
+void Autopilot::ensureSize(int new_width, int new_height) {
+    if (new_width == width && new_height == height) return;
+    width = new_width;
+    height = new_height;
+    size_t cells = (size_t)width * height;
+    parent.assign(cells, -1);
+    dist.assign(cells, 0);
+    seen.assign(cells, 0);
+    queue.assign(cells, 0);
+    next.assign(cells, 0);
+    entered.assign(cells, 0);
+    stamp = 0;
+    last_head = -1;
+    buildCycle();
+}
+
+// Boustrophedon cycle: snake through columns 1.. row by row and come back up column 0.
+// Needs an even number of rows, so odd-height boards use the transposed layout.
+void Autopilot::buildCycle() {
+    cycle_pos.clear();
+    bool transpose = height % 2 != 0;
+    int w = transpose ? height : width;
+    int h = transpose ? width : height;
+    if (h % 2 != 0 || w < 2) return;
+
+    vector<int32_t> cycle_next((size_t)width * height, -1);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int nx = x, ny = y;
+            if (x == 0) {
+                if (y > 0) ny = y - 1; else nx = 1;
+            } else if (y % 2 == 0) {
+                if (x < w - 1) nx = x + 1; else ny = y + 1;
+            } else {
+                if (x > 1) nx = x - 1;
+                else if (y == h - 1) nx = 0;
+                else ny = y + 1;
+            }
+            int from = transpose ? x * width + y : y * width + x;
+            int to = transpose ? nx * width + ny : ny * width + nx;
+            cycle_next[from] = to;
+        }
+    }
+    cycle_pos.assign(cycle_next.size(), 0);
+    for (int i = 0, c = 0; i < (int)cycle_next.size(); ++i, c = cycle_next[c]) cycle_pos[c] = i;
+}
+
+// Only the new head needs stamping after a normal tick, a reset or skipped tick rebuilds
+void Autopilot::trackBody(const Game& game) {
+    const auto& snake = game.getSnake();
+    int64_t now = (int64_t)game.getTicks();
+    int head = (int)snake.cellAt(0);
+    bool follows = snake.size() > 1 && game.getTicks() == last_ticks + 1 && (int)snake.cellAt(1) == last_head;
+    if (follows) {
+        entered[head] = now;
+    } else {
+        int64_t t = now;
+        for (size_t i = 0; i < snake.size(); ++i) entered[snake.cellAt(i)] = t--;
+        // Level cells are never vacated. Left over marks on cells that are free later are
+        // harmless since passable() looks at the board first.
+        if (const Level* level = game.getLevel()) {
+            for (int cell : level->obstacles) entered[cell] = NEVER;
+            for (const auto& pair : level->portals) entered[pair.first] = entered[pair.second] = NEVER;
+        }
+    }
+    last_ticks = game.getTicks();
+    last_head = head;
+    tail = (int)snake.cellAt(snake.size() - 1);
+}
+
+// A body cell is gone once every segment behind it has left, arrival counts ticks from now
+bool Autopilot::passable(const Board& board, int cell, int arrival) const {
+    if (board.isFreeCell(cell)) return true;
+    return entered[cell] - entered[tail] + 1 + delay <= arrival;
+}
+
+bool Autopilot::deadlineHit() const {
+    return std::chrono::steady_clock::now() >= deadline;
+}
+
+// With unit steps and the Manhattan heuristic a neighbour's f is either the current f
+// (a step towards the goal) or f + 2, so two stacks replace the priority queue.
+int Autopilot::search(const Board& board, int start, int start_dist, int goal, bool escape) {
+    if (out_of_time) return -1;
+    if (++stamp == 0) {
+        std::fill(seen.begin(), seen.end(), 0);
+        stamp = 1;
+    }
+    int gx = goal % width;
+    int gy = goal / width;
+    size_t now_len = 0, next_len = 0;
+    queue[now_len++] = start;
+    seen[start] = stamp;
+    dist[start] = start_dist;
+    size_t popped = 0;
+    while (now_len > 0) {
+        if ((++popped & 1023) == 0 && deadlineHit()) {
+            out_of_time = true;
+            return -1;
+        }
+        int c = queue[--now_len];
+        int x = c % width;
+        int y = c / width;
+        int arrival = dist[c] + 1;
+        for (int d = 0; d < 4; ++d) {
+            int nx = x + DX[d];
+            int ny = y + DY[d];
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+            int n = ny * width + nx;
+            if (seen[n] == stamp || !passable(board, n, arrival)) continue;
+            seen[n] = stamp;
+            parent[n] = c;
+            dist[n] = arrival;
+            if (n == goal || (escape && !board.isFreeCell(n))) return n;
+            bool closer = std::abs(nx - gx) + std::abs(ny - gy) < std::abs(x - gx) + std::abs(y - gy);
+            if (closer) queue[now_len++] = n;
+            else next[next_len++] = n;
+        }
+        if (now_len == 0) {
+            std::swap(queue, next);
+            now_len = next_len;
+            next_len = 0;
+        }
+    }
+    return -1;
+}
+
+Direction Autopilot::towards(int from, int to) const {
+    int dx = to % width - from % width;
+    int dy = to / width - from / width;
+    if (dx > 0) return RIGHT;
+    if (dx < 0) return LEFT;
+    return dy > 0 ? DOWN : UP;
+}
+
+Direction Autopilot::choose(const Game& game) {
+    const Board& board = game.getBoard();
+    if (game.getSnake().empty()) return game.getDirection();
+    ensureSize(board.getWidth(), board.getHeight());
+    deadline = std::chrono::steady_clock::now() + budget;
+    out_of_time = false;
+    trackBody(game);
+
+    int head = last_head;
+    int hx = head % width;
+    int hy = head / width;
+    // Foods nearest first, a level can have several out and some may be out of reach
+    targets.clear();
+    for (const auto& f : game.getFoods()) {
+        if (f.x >= 0) targets.push_back({std::abs(f.x - hx) + std::abs(f.y - hy), f.y * width + f.x});
+    }
+    std::sort(targets.begin(), targets.end());
+    int food = targets.empty() ? -1 : targets[0].second;
+
+    // Path to a food, taken only if the snake can still escape after its first step
+    for (const auto& target : targets) {
+        int goal = target.second;
+        delay = 0;
+        if (search(board, head, 0, goal, false) == goal) {
+            int step = goal;
+            while (parent[step] != head) step = parent[step];
+            delay = step == goal ? 1 : 0;
+            if (search(board, step, 1, tail, true) >= 0) return towards(head, step);
+        }
+        if (out_of_time) break;
+    }
+
+    // Any escapable move. Prefer moves that stay behind the tail in cycle order and are
+    // closest to the food along the cycle, so the snake sweeps the board.
+    int options[4];
+    int rank[4];
+    int count = 0;
+    int cells = width * height;
+    for (int d = 0; d < 4; ++d) {
+        int nx = hx + DX[d];
+        int ny = hy + DY[d];
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+        int n = ny * width + nx;
+        int r = 0;
+        if (!cycle_pos.empty()) {
+            int to_n = (cycle_pos[n] - cycle_pos[head] + cells) % cells;
+            int to_tail = (cycle_pos[tail] - cycle_pos[head] + cells) % cells;
+            int n_to_food = food >= 0 ? (cycle_pos[food] - cycle_pos[n] + cells) % cells : 0;
+            r = (to_n <= to_tail ? 0 : cells) + n_to_food;
+        }
+        int i = count++;
+        while (i > 0 && rank[i - 1] > r) {
+            options[i] = options[i - 1];
+            rank[i] = rank[i - 1];
+            --i;
+        }
+        options[i] = n;
+        rank[i] = r;
+    }
+
+    for (int i = 0; i < count && !out_of_time; ++i) {
+        int n = options[i];
+        delay = 0;
+        if (!passable(board, n, 1)) continue;
+        delay = n == food ? 1 : 0;
+        if (search(board, n, 1, tail, true) >= 0) return towards(head, n);
+    }
+
+    // Trapped or out of time: take the best ranked open neighbour
+    delay = 0;
+    for (int i = 0; i < count; ++i) {
+        if (passable(board, options[i], 1)) return towards(head, options[i]);
+    }
+    return game.getDirection();
+}
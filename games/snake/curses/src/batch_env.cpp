@@ -0,0 +1,277 @@
+#include "batch_env.h"
+#include "game.h"
+#include "rng.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+// Direction values double as indices here: UP, DOWN, LEFT, RIGHT
+static const int DX[4] = {0, 0, -1, 1};
+static const int DY[4] = {-1, 1, 0, 0};
+
+struct SnakeBatch {
+    int n;
+    int width, height, cells;
+
+    // One entry per board
+    vector<int32_t> hx, hy;
+    vector<int8_t> dir;
+    vector<int32_t> heads, food, scores;
+    vector<int32_t> ring_head, len;
+    vector<int32_t> free_count;
+    vector<Rng> rng;
+
+    // n * cells arena, board e owns [e * cells, (e + 1) * cells)
+    vector<int32_t> body;
+    vector<uint8_t> occ;
+    vector<int32_t> free_cells, free_pos;
+
+    // Per step scratch filled by the vector pass
+    vector<int32_t> nx, ny;
+    vector<uint8_t> wall;
+
+    // Worker pool, shard 0 runs on the calling thread
+    int shards;
+    vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable work_cv, done_cv;
+    uint64_t generation = 0;
+    int pending = 0;
+    bool stop = false;
+    const int8_t* actions = nullptr;
+    float* rewards = nullptr;
+    uint8_t* done = nullptr;
+
+    SnakeBatch(int n, int width, int height, uint64_t seed, int threads);
+    ~SnakeBatch();
+
+    void occupy(int e, int cell);
+    void vacate(int e, int cell);
+    int32_t spawnFood(int e);
+    void resetBoard(int e);
+    void stepRange(int begin, int end);
+    void runShard(int shard);
+    void worker(int shard);
+};
+
+SnakeBatch::SnakeBatch(int n, int width, int height, uint64_t seed, int threads)
+    : n(n), width(width), height(height), cells(width * height) {
+    hx.resize(n);
+    hy.resize(n);
+    dir.resize(n);
+    heads.resize(n);
+    food.resize(n);
+    scores.resize(n);
+    ring_head.assign(n, 0);
+    len.assign(n, 0);
+    free_count.assign(n, cells);
+    nx.resize(n);
+    ny.resize(n);
+    wall.resize(n);
+    rng.reserve(n);
+    for (int e = 0; e < n; ++e) rng.emplace_back(seed + (uint64_t)e * 0x9e3779b97f4a7c15ULL);
+
+    size_t arena = (size_t)n * cells;
+    body.resize(arena);
+    occ.assign(arena, 0);
+    free_cells.resize(arena);
+    free_pos.resize(arena);
+    for (int e = 0; e < n; ++e) {
+        int32_t* fc = &free_cells[(size_t)e * cells];
+        int32_t* fp = &free_pos[(size_t)e * cells];
+        for (int i = 0; i < cells; ++i) {
+            fc[i] = i;
+            fp[i] = i;
+        }
+        resetBoard(e);
+    }
+
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    shards = std::max(1, std::min(threads, n));
+    for (int s = 1; s < shards; ++s) workers.emplace_back(&SnakeBatch::worker, this, s);
+}
+
+SnakeBatch::~SnakeBatch() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stop = true;
+    }
+    work_cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void SnakeBatch::occupy(int e, int cell) {
+    size_t base = (size_t)e * cells;
+    occ[base + cell] = 1;
+    int32_t slot = free_pos[base + cell];
+    int32_t last = free_cells[base + --free_count[e]];
+    free_cells[base + slot] = last;
+    free_pos[base + last] = slot;
+    free_pos[base + cell] = -1;
+}
+
+void SnakeBatch::vacate(int e, int cell) {
+    size_t base = (size_t)e * cells;
+    occ[base + cell] = 0;
+    free_pos[base + cell] = free_count[e];
+    free_cells[base + free_count[e]++] = cell;
+}
+
+int32_t SnakeBatch::spawnFood(int e) {
+    if (free_count[e] == 0) return -1;
+    return free_cells[(size_t)e * cells + rng[e].below(free_count[e])];
+}
+
+// Same starting position as Game::reset, clearing only the cells the old body used
+void SnakeBatch::resetBoard(int e) {
+    const int32_t* ring = &body[(size_t)e * cells];
+    for (int i = 0, r = ring_head[e]; i < len[e]; ++i, r = (r + 1 == cells) ? 0 : r + 1) {
+        vacate(e, ring[r]);
+    }
+    int sx = width / 2;
+    int sy = height / 2;
+    int32_t* out = &body[(size_t)e * cells];
+    for (int i = 0; i < 3; ++i) {
+        out[i] = sy * width + sx + 1 - i;
+        occupy(e, out[i]);
+    }
+    ring_head[e] = 0;
+    len[e] = 3;
+    hx[e] = sx + 1;
+    hy[e] = sy;
+    heads[e] = out[0];
+    dir[e] = RIGHT;
+    scores[e] = 0;
+    food[e] = spawnFood(e);
+}
+
+void SnakeBatch::stepRange(int begin, int end) {
+    // Flat pass over the per-board arrays: apply actions, move heads, test walls
+    for (int e = begin; e < end; ++e) {
+        int d = dir[e];
+        int a = actions ? actions[e] : -1;
+        if (a >= 0 && a < 4 && (a ^ 1) != d) d = a;
+        dir[e] = (int8_t)d;
+        nx[e] = hx[e] + DX[d];
+        ny[e] = hy[e] + DY[d];
+        wall[e] = ((unsigned)nx[e] >= (unsigned)width) | ((unsigned)ny[e] >= (unsigned)height);
+    }
+
+    for (int e = begin; e < end; ++e) {
+        rewards[e] = 0.0f;
+        done[e] = 0;
+        bool dead = wall[e];
+        if (!dead) {
+            int cell = ny[e] * width + nx[e];
+            bool grow = cell == food[e];
+            int32_t* ring = &body[(size_t)e * cells];
+            if (!grow) {
+                int tail = ring_head[e] + len[e] - 1;
+                if (tail >= cells) tail -= cells;
+                vacate(e, ring[tail]);
+                len[e]--;
+            }
+            if (occ[(size_t)e * cells + cell]) {
+                dead = true;
+            } else {
+                ring_head[e] = ring_head[e] == 0 ? cells - 1 : ring_head[e] - 1;
+                ring[ring_head[e]] = cell;
+                len[e]++;
+                occupy(e, cell);
+                hx[e] = nx[e];
+                hy[e] = ny[e];
+                heads[e] = cell;
+                if (grow) {
+                    scores[e]++;
+                    rewards[e] = 1.0f;
+                    food[e] = spawnFood(e);
+                }
+            }
+        }
+        if (dead) {
+            rewards[e] = -1.0f;
+            done[e] = 1;
+            resetBoard(e);
+        }
+    }
+}
+
+void SnakeBatch::runShard(int shard) {
+    int begin = (int)((int64_t)n * shard / shards);
+    int end = (int)((int64_t)n * (shard + 1) / shards);
+    stepRange(begin, end);
+}
+
+void SnakeBatch::worker(int shard) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        work_cv.wait(lk, [&] { return stop || generation != seen; });
+        if (stop) return;
+        seen = generation;
+        lk.unlock();
+        runShard(shard);
+        lk.lock();
+        if (--pending == 0) done_cv.notify_one();
+    }
+}
+
+extern "C" {
+
+SnakeBatch* snake_batch_create(int batch, int width, int height, uint64_t seed, int threads) {
+    if (batch <= 0 || width < 4 || height < 1) return nullptr;
+    return new SnakeBatch(batch, width, height, seed, threads);
+}
+
+void snake_batch_destroy(SnakeBatch* env) {
+    delete env;
+}
+
+void snake_batch_reset(SnakeBatch* env) {
+    for (int e = 0; e < env->n; ++e) env->resetBoard(e);
+}
+
+void snake_batch_step(SnakeBatch* env, const int8_t* actions, float* rewards, uint8_t* done) {
+    env->actions = actions;
+    env->rewards = rewards;
+    env->done = done;
+    if (env->shards == 1) {
+        env->stepRange(0, env->n);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(env->m);
+        env->pending = env->shards - 1;
+        env->generation++;
+    }
+    env->work_cv.notify_all();
+    env->runShard(0);
+    std::unique_lock<std::mutex> lk(env->m);
+    env->done_cv.wait(lk, [&] { return env->pending == 0; });
+}
+
+int snake_batch_size(const SnakeBatch* env) {
+    return env->n;
+}
+
+const uint8_t* snake_batch_occupancy(const SnakeBatch* env) {
+    return env->occ.data();
+}
+
+const int32_t* snake_batch_heads(const SnakeBatch* env) {
+    return env->heads.data();
+}
+
+const int32_t* snake_batch_food(const SnakeBatch* env) {
+    return env->food.data();
+}
+
+const int32_t* snake_batch_scores(const SnakeBatch* env) {
+    return env->scores.data();
+}
+
+}
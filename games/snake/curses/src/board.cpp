@@ -0,0 +1,147 @@
+#include "board.h"
+#include <algorithm>
+
+Board::Board(int width, int height) : width(0), height(0), chunked(false), tilesX(0), occupiedCount(0) {
+    resize(width, height);
+}
+
+void Board::resize(int new_width, int new_height) {
+    width = new_width;
+    height = new_height;
+    int64_t cells = (int64_t)width * height;
+    chunked = cells > DENSE_MAX_CELLS;
+    occupiedCount = 0;
+    if (chunked) {
+        occupied.clear();
+        occupied.shrink_to_fit();
+        freeCells.clear();
+        freeCells.shrink_to_fit();
+        freePos.clear();
+        freePos.shrink_to_fit();
+        tilesX = (width + TILE_MASK) >> TILE_SHIFT;
+        size_t tileCount = (size_t)tilesX * ((height + TILE_MASK) >> TILE_SHIFT);
+        tiles.clear();
+        tiles.resize(tileCount);
+        tileCounts.assign(tileCount, 0);
+        return;
+    }
+    tiles.clear();
+    tileCounts.clear();
+    occupied.assign((cells + 63) / 64, 0);
+    freeCells.resize(cells);
+    freePos.resize(cells);
+    for (int i = 0; i < cells; ++i) {
+        freeCells[i] = i;
+        freePos[i] = i;
+    }
+}
+
+void Board::copyFrom(const Board& other) {
+    width = other.width;
+    height = other.height;
+    chunked = other.chunked;
+    tilesX = other.tilesX;
+    occupiedCount = other.occupiedCount;
+    occupied = other.occupied;
+    freeCells = other.freeCells;
+    freePos = other.freePos;
+    tileCounts = other.tileCounts;
+    tiles.clear();
+    tiles.resize(other.tiles.size());
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        if (!other.tiles[t]) continue;
+        tiles[t].reset(new uint64_t[1 << TILE_SHIFT]);
+        std::copy(other.tiles[t].get(), other.tiles[t].get() + (1 << TILE_SHIFT), tiles[t].get());
+    }
+}
+
+void Board::occupy(int x, int y) {
+    if (chunked) {
+        size_t t = (size_t)(y >> TILE_SHIFT) * tilesX + (x >> TILE_SHIFT);
+        if (!tiles[t]) tiles[t].reset(new uint64_t[1 << TILE_SHIFT]());
+        uint64_t& row = tiles[t][y & TILE_MASK];
+        uint64_t bit = 1ULL << (x & TILE_MASK);
+        if (row & bit) return;
+        row |= bit;
+        tileCounts[t]++;
+        occupiedCount++;
+        return;
+    }
+    int idx = y * width + x;
+    uint64_t bit = 1ULL << (idx & 63);
+    if (occupied[idx >> 6] & bit) return;
+    occupied[idx >> 6] |= bit;
+    int slot = freePos[idx];
+    int last = freeCells.back();
+    freeCells[slot] = last;
+    freePos[last] = slot;
+    freeCells.pop_back();
+    freePos[idx] = -1;
+}
+
+void Board::vacate(int x, int y) {
+    if (chunked) {
+        size_t t = (size_t)(y >> TILE_SHIFT) * tilesX + (x >> TILE_SHIFT);
+        if (!tiles[t]) return;
+        uint64_t& row = tiles[t][y & TILE_MASK];
+        uint64_t bit = 1ULL << (x & TILE_MASK);
+        if (!(row & bit)) return;
+        row &= ~bit;
+        occupiedCount--;
+        if (--tileCounts[t] == 0) tiles[t].reset();
+        return;
+    }
+    int idx = y * width + x;
+    uint64_t bit = 1ULL << (idx & 63);
+    if (!(occupied[idx >> 6] & bit)) return;
+    occupied[idx >> 6] &= ~bit;
+    freePos[idx] = (int)freeCells.size();
+    freeCells.push_back(idx);
+}
+
+bool Board::inBounds(int x, int y) const {
+    return x >= 0 && x < width && y >= 0 && y < height;
+}
+
+bool Board::isFree(int x, int y) const {
+    if (chunked) {
+        const auto& tile = tiles[(size_t)(y >> TILE_SHIFT) * tilesX + (x >> TILE_SHIFT)];
+        return !tile || !(tile[y & TILE_MASK] >> (x & TILE_MASK) & 1);
+    }
+    return isFreeCell(y * width + x);
+}
+
+bool Board::isFreeCell(int cell) const {
+    if (chunked) return isFree(cell % width, cell / width);
+    return !(occupied[cell >> 6] >> (cell & 63) & 1);
+}
+
+int Board::freeCount() const {
+    if (chunked) return width * height - occupiedCount;
+    return (int)freeCells.size();
+}
+
+int Board::freeCellAt(int r) const {
+    return freeCells[r];
+}
+
+int Board::randomFreeCell(Rng& rng) const {
+    if (freeCount() == 0) return -1;
+    if (!chunked) return freeCells[rng.below(freeCount())];
+    while (true) {
+        int cell = (int)rng.below((uint32_t)(width * height));
+        if (isFreeCell(cell)) return cell;
+    }
+}
+
+bool Board::isChunked() const {
+    return chunked;
+}
+
+int Board::getWidth() const {
+    return width;
+}
+
+int Board::getHeight() const {
+    return height;
+}
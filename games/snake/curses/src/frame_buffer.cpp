@@ -0,0 +1,64 @@
+#include "frame_buffer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+FrameBuffer::FrameBuffer(size_t capacity) : buf(capacity), len(0) {}
+
+void FrameBuffer::append(const char* s, size_t n) {
+    if (len + n > buf.size()) buf.resize(std::max(buf.size() * 2, len + n));
+    memcpy(buf.data() + len, s, n);
+    len += n;
+}
+
+void FrameBuffer::append(const char* s) {
+    append(s, strlen(s));
+}
+
+void FrameBuffer::appendInt(int v) {
+    char tmp[12];
+    char* end = tmp + sizeof(tmp);
+    char* p = end;
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) *--p = '-';
+    append(p, end - p);
+}
+
+void FrameBuffer::moveCursor(int row, int col) {
+    append("\033[", 2);
+    appendInt(row);
+    append(";", 1);
+    appendInt(col);
+    append("H", 1);
+}
+
+size_t FrameBuffer::flush(int fd) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, buf.data() + off, len - off);
+        if (w < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            break;
+        }
+        off += w;
+    }
+    len = 0;
+    return off;
+}
+
+void FrameBuffer::clear() {
+    len = 0;
+}
+
+size_t FrameBuffer::size() const {
+    return len;
+}
+
+const char* FrameBuffer::data() const {
+    return buf.data();
+}
@@ -8,12 +8,12 @@
 #include <ctime>
 #include <unistd.h>
 #include <iostream>
+#include <poll.h>
+#include <signal.h>
 #include <termios.h>
-#include <thread>
 
 using std::string;
 using std::vector;
-using std::deque;
 
 const vector<Difficulty> DIFFICULTIES = {
     {"Easy",   4.0,  0.98, 1.4},
@@ -23,12 +23,28 @@ const vector<Difficulty> DIFFICULTIES = {
 };
 
 Game::Game(int width, int height, int diffIndex)
-    : width(width), height(height), diffIndex(diffIndex), score(0), alive(true), paused(false), dir(RIGHT) {
-    reset();
+    : Game(width, height, diffIndex, (uint64_t)time(nullptr) ^ ((uint64_t)getpid() << 32)) {
     highscore = loadHighscore();
 }
 
-Game::Game(int width, int height, int diffIndex, std::deque<Point> initial_snake, Point initial_food)
+Game::Game(int width, int height, int diffIndex, uint64_t seed)
+    : width(width),
+      height(height),
+      diffIndex(diffIndex),
+      score(0),
+      highscore(0),
+      alive(true),
+      paused(false),
+      ticks(0),
+      seed(seed),
+      dir(RIGHT),
+      snake(width, height),
+      board(width, height),
+      rng(seed) {
+    reset();
+}
+
+Game::Game(int width, int height, int diffIndex, const std::vector<Point>& initial_snake, Point initial_food)
     : width(width),
       height(height),
       diffIndex(diffIndex),
@@ -36,53 +52,139 @@ Game::Game(int width, int height, int diffIndex, std::deque<Point> initial_snake
       highscore(0),
       alive(true),
       paused(false),
+      ticks(0),
+      seed(Rng::DEFAULT_SEED),
       dir(RIGHT),
-      snake(std::move(initial_snake)),
-      food(initial_food) {
-    next_tick = clock::now();
+      snake(width, height),
+      foods(1, initial_food),
+      board(width, height) {
+    for (auto it = initial_snake.rbegin(); it != initial_snake.rend(); ++it) {
+        if (!board.inBounds(it->x, it->y)) continue;
+        snake.pushFront(*it);
+        board.occupy(it->x, it->y);
+    }
+}
+
+static bool testBit(const vector<uint64_t>& bits, int cell) {
+    return bits[cell >> 6] >> (cell & 63) & 1;
+}
+
+Game::Game(const Level& level, int diffIndex)
+    : Game(level, diffIndex, (uint64_t)time(nullptr) ^ ((uint64_t)getpid() << 32)) {
+    highscore = loadHighscore();
+}
+
+Game::Game(const Level& level, int diffIndex, uint64_t seed)
+    : width(level.width),
+      height(level.height),
+      diffIndex(diffIndex),
+      score(0),
+      highscore(0),
+      alive(true),
+      paused(false),
+      ticks(0),
+      seed(seed),
+      dir(RIGHT),
+      snake(level.width, level.height),
+      board(level.width, level.height),
+      rng(seed),
+      has_level(true),
+      level(level),
+      level_board(level.width, level.height) {
+    size_t words = ((size_t)width * height + 63) / 64;
+    obstacle_bits.assign(words, 0);
+    portal_bits.assign(words, 0);
+    food_bits.assign(words, 0);
+    // Obstacles and portal mouths are never free, so neither snake nor food lands on them
+    for (int cell : level.obstacles) level_board.occupy(cell % width, cell / width);
+    for (const auto& pair : level.portals) {
+        level_board.occupy(pair.first % width, pair.first / width);
+        level_board.occupy(pair.second % width, pair.second / width);
+    }
+    for (int cell : level.obstacles) obstacle_bits[cell >> 6] |= 1ULL << (cell & 63);
+    for (const auto& pair : level.portals) {
+        portal_bits[pair.first >> 6] |= 1ULL << (pair.first & 63);
+        portal_bits[pair.second >> 6] |= 1ULL << (pair.second & 63);
+    }
+    reset();
 }
 
 void Game::reset() {
-    int sx = width / 2;
-    int sy = height / 2;
-    snake.clear();
-    snake.push_back({sx + 1, sy});
-    snake.push_back({sx, sy});
-    snake.push_back({sx - 1, sy});
+    int sx = has_level ? level.start.x - 1 : width / 2;
+    int sy = has_level ? level.start.y : height / 2;
+    snake.reset(width, height);
+    snake.pushFront({sx - 1, sy});
+    snake.pushFront({sx, sy});
+    snake.pushFront({sx + 1, sy});
+    // Restoring the level's board is a plain copy, much cheaper than occupying every
+    // obstacle again
+    if (has_level) board.copyFrom(level_board);
+    else board.resize(width, height);
+    for (const auto& p : snake) board.occupy(p.x, p.y);
     dir = RIGHT;
-    food = randomFood();
+    turn_count = 0;
+    foods.clear();
+    if (!has_level) {
+        foods.push_back(randomFood());
+    } else {
+        std::fill(food_bits.begin(), food_bits.end(), 0);
+        for (int i = 0; i < level.food_count; ++i) {
+            foods.push_back(randomFood());
+            if (foods.back().x >= 0) setFoodBit(foods.back(), true);
+        }
+    }
     score = 0;
+    ticks = 0;
     alive = true;
     paused = false;
-    next_tick = clock::now();
 }
 
 void Game::processInput(Input* input) {
-    UserAction action = input->getUserAction(dir);
-    switch (action) {
-        case UserAction::UP: dir = UP; break;
-        case UserAction::DOWN: dir = DOWN; break;
-        case UserAction::LEFT: dir = LEFT; break;
-        case UserAction::RIGHT: dir = RIGHT; break;
-        case UserAction::PAUSE: paused = !paused; break;
-        case UserAction::QUIT: alive = false; break;
-        default: break;
+    input->readPending();
+    for (UserAction action = input->pop(); action != UserAction::NONE; action = input->pop()) {
+        switch (action) {
+            case UserAction::UP: queueTurn(UP); break;
+            case UserAction::DOWN: queueTurn(DOWN); break;
+            case UserAction::LEFT: queueTurn(LEFT); break;
+            case UserAction::RIGHT: queueTurn(RIGHT); break;
+            case UserAction::PAUSE: paused = !paused; break;
+            case UserAction::QUIT: alive = false; break;
+            default: break;
+        }
     }
 }
 
-void Game::update() {
-    if (!alive) return;
+static bool isTurn(Direction from, Direction to) {
+    if (from == to) return false;
+    return !((from == UP && to == DOWN) || (from == DOWN && to == UP) || (from == LEFT && to == RIGHT) ||
+             (from == RIGHT && to == LEFT));
+}
 
-    if (paused) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(30));
-        return;
-    }
+void Game::queueTurn(Direction turn) {
+    if (turn_count < MAX_TURNS) turns[turn_count++] = turn;
+}
 
-    auto now = clock::now();
-    if (now < next_tick) {
-        std::this_thread::sleep_for(next_tick - now);
+Direction Game::nextDirection() const {
+    for (int i = 0; i < turn_count; ++i) {
+        if (isTurn(dir, turns[i])) return turns[i];
     }
-    next_tick += std::chrono::milliseconds(computeTickMs());
+    return dir;
+}
+
+// Takes the first queued turn that changes direction, dropping the ones before it
+void Game::takeTurn() {
+    int i = 0;
+    while (i < turn_count && !isTurn(dir, turns[i])) ++i;
+    if (i < turn_count) dir = turns[i++];
+    std::copy(turns + i, turns + turn_count, turns);
+    turn_count -= i;
+}
+
+void Game::step() {
+    changes.clear();
+    if (!alive || paused) return;
+    ticks++;
+    if (turn_count > 0) takeTurn();
 
     Point newHead = snake.front();
     switch (dir) {
@@ -92,62 +194,119 @@ void Game::update() {
         case RIGHT: newHead.x++; break;
     }
 
-    if (newHead.x < 0 || newHead.x * 2 >= width * 2 || newHead.y < 0 || newHead.y >= height) {
+    if (!board.inBounds(newHead.x, newHead.y)) {
         alive = false;
         return;
     }
+    if (has_level && isPortal(newHead.x, newHead.y)) {
+        newHead = portalExit(newHead);
+        if (!board.inBounds(newHead.x, newHead.y)) {
+            alive = false;
+            return;
+        }
+    }
 
-    bool willGrow = (newHead == food);
-
-    snake.push_front(newHead);
+    int eaten = foodAt(newHead);
+    bool willGrow = eaten >= 0;
 
+    // Vacate the tail first so moving into the old tail cell stays legal
     if (!willGrow) {
-        snake.pop_back();
-    } else {
+        Point tail = snake.back();
+        board.vacate(tail.x, tail.y);
+        changes.push_back({tail, CellKind::EMPTY});
+        snake.popBack();
+    }
+
+    if (!board.isFree(newHead.x, newHead.y)) {
+        alive = false;
+        return;
+    }
+
+    if (!snake.empty()) changes.push_back({snake.front(), CellKind::BODY});
+    snake.pushFront(newHead);
+    board.occupy(newHead.x, newHead.y);
+    changes.push_back({newHead, CellKind::HEAD});
+
+    if (willGrow) {
         score++;
         if (score > highscore) {
             highscore = score;
         }
-        food = randomFood();
-    }
-
-    // Self-collision check after moving
-    for (auto it = snake.begin() + 1; it != snake.end(); ++it) {
-        if (*it == snake.front()) {
-            alive = false;
-            return;
+        if (has_level) setFoodBit(newHead, false);
+        foods[eaten] = randomFood();
+        if (foods[eaten].x >= 0) {
+            if (has_level) setFoodBit(foods[eaten], true);
+            changes.push_back({foods[eaten], CellKind::FOOD});
         }
     }
 }
 
+void Game::reseed(uint64_t new_seed) {
+    seed = new_seed;
+    rng.reseed(new_seed);
+}
+
+// A level's size is fixed, so resizing one just restarts it and reports its size back
 void Game::resize(int& new_width, int& new_height) {
+    if (has_level) {
+        new_width = width;
+        new_height = height;
+    }
     width = new_width;
     height = new_height;
     reset();
 }
 
 Point Game::randomFood() {
-    vector<Point> freeCells;
-    freeCells.reserve(width * height);
-    for (int yy = 0; yy < height; ++yy) {
-        for (int xx = 0; xx < width; ++xx) {
-            Point p{xx, yy};
-            if (std::find(snake.begin(), snake.end(), p) == snake.end()) {
-                freeCells.push_back(p);
-            }
-        }
+    // Only other foods can be in the way, so this retries at most a handful of times
+    // unless the free cells are nearly all food
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        int idx = board.randomFreeCell(rng);
+        if (idx < 0) return {-1, -1};
+        Point p = {idx % width, idx / width};
+        if (foods.size() <= 1 || foodAt(p) < 0) return p;
+    }
+    return {-1, -1};
+}
+
+// The bitboard answers for nearly every cell, the scan only runs on an actual food
+int Game::foodAt(const Point& p) const {
+    if (has_level && !testBit(food_bits, p.y * width + p.x)) return -1;
+    for (size_t i = 0; i < foods.size(); ++i) {
+        if (foods[i] == p) return (int)i;
     }
-    if (freeCells.empty()) return {-1, -1};
-    static bool seeded = false;
-    if (!seeded) { srand(time(nullptr) ^ getpid()); seeded = true; }
-    return freeCells[rand() % freeCells.size()];
+    return -1;
+}
+
+void Game::setFoodBit(const Point& p, bool on) {
+    int cell = p.y * width + p.x;
+    if (on) food_bits[cell >> 6] |= 1ULL << (cell & 63);
+    else food_bits[cell >> 6] &= ~(1ULL << (cell & 63));
 }
 
-int Game::computeTickMs() {
+Point Game::portalExit(const Point& entry) const {
+    int cell = entry.y * width + entry.x;
+    int exit = cell;
+    for (const auto& pair : level.portals) {
+        if (pair.first == cell) exit = pair.second;
+        else if (pair.second == cell) exit = pair.first;
+    }
+    Point out = {exit % width, exit / width};
+    switch (dir) {
+        case UP: out.y--; break;
+        case DOWN: out.y++; break;
+        case LEFT: out.x--; break;
+        case RIGHT: out.x++; break;
+    }
+    return out;
+}
+
+int Game::computeTickMs() const {
     const Difficulty& D = DIFFICULTIES[diffIndex];
     double target_cross = D.base_cross_time;
-    target_cross = target_cross * sqrt((double)width / 40.0);
-    double step_seconds = target_cross / std::max(1, width);
+    int pace = pace_width > 0 ? pace_width : width;
+    target_cross = target_cross * sqrt((double)pace / 40.0);
+    double step_seconds = target_cross / std::max(1, pace);
     step_seconds *= D.difficulty_speed_mul;
     step_seconds *= pow(D.score_accel, score);
     double min_step = 0.02;
@@ -156,6 +315,10 @@ int Game::computeTickMs() {
     return (int)round(step_seconds * 1000.0);
 }
 
+void Game::setPaceWidth(int new_width) {
+    pace_width = new_width;
+}
+
 bool Game::isGameOver() const {
     return !alive;
 }
@@ -168,12 +331,49 @@ int Game::getHighscore() const {
     return highscore;
 }
 
-const deque<Point>& Game::getSnake() const {
+int Game::getDifficulty() const {
+    return diffIndex;
+}
+
+uint64_t Game::getSeed() const {
+    return seed;
+}
+
+uint64_t Game::getTicks() const {
+    return ticks;
+}
+
+const SnakeBody& Game::getSnake() const {
     return snake;
 }
 
 const Point& Game::getFood() const {
-    return food;
+    static const Point NONE = {-1, -1};
+    return foods.empty() ? NONE : foods[0];
+}
+
+const vector<Point>& Game::getFoods() const {
+    return foods;
+}
+
+const Level* Game::getLevel() const {
+    return has_level ? &level : nullptr;
+}
+
+bool Game::isObstacle(int x, int y) const {
+    return has_level && testBit(obstacle_bits, y * width + x);
+}
+
+bool Game::isPortal(int x, int y) const {
+    return has_level && testBit(portal_bits, y * width + x);
+}
+
+const vector<CellChange>& Game::getChanges() const {
+    return changes;
+}
+
+const Board& Game::getBoard() const {
+    return board;
 }
 
 Direction Game::getDirection() const {
@@ -182,6 +382,7 @@ Direction Game::getDirection() const {
 
 void Game::setDirection(Direction new_dir) {
     dir = new_dir;
+    turn_count = 0;
 }
 
 bool Game::isPaused() const {
@@ -209,7 +410,7 @@ void saveHighscore(int v) {
     if (out.is_open()) out << v << "\n";
 }
 
-int promptDifficulty() {
+int promptDifficulty(Terminal& term) {
     struct termios t;
     if (tcgetattr(STDIN_FILENO, &t) == 0) {
         t.c_lflag |= (ICANON | ECHO);
@@ -226,7 +427,14 @@ int promptDifficulty() {
 
     int choice = 1;
     char c = 0;
+    pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {term.signalFd(), POLLIN, 0}};
     while (true) {
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents & POLLIN) {
+            int sig = term.readSignal();
+            if (sig == SIGINT || sig == SIGTERM) return -1;
+        }
+        if (!(fds[0].revents & POLLIN)) continue;
         if (read(STDIN_FILENO, &c, 1) <= 0) continue;
         if (c >= '1' && c <= '0' + (int)DIFFICULTIES.size()) {
             choice = c - '1';
@@ -1,5 +1,4 @@
 #include "input.h"
-#include "game.h"
 #include <unistd.h>
 #include <sys/select.h>
 
@@ -17,45 +16,86 @@ int Input::readBytes(char* buf, int n) {
     return (int)r;
 }
 
-UserAction Input::getUserAction(Direction currentDirection) {
-    if (!kbhit()) {
-        return UserAction::NONE;
+static UserAction arrow(char c) {
+    switch (c) {
+        case 'A': return UserAction::UP;
+        case 'B': return UserAction::DOWN;
+        case 'C': return UserAction::RIGHT;
+        case 'D': return UserAction::LEFT;
+        default: return UserAction::NONE;
     }
+}
 
-    char buf[32];
-    int n = readBytes(buf, sizeof(buf));
-    for (int i = 0; i < n; ++i) {
-        char c = buf[i];
-        if (c == '\033') { // escape seq
-            char b1 = 0, b2 = 0;
-            if (i + 2 < n) {
-                b1 = buf[i + 1];
-                b2 = buf[i + 2];
-                i += 2;
-            } else {
-                char tmp[2];
-                int r = readBytes(tmp, 2);
-                if (r >= 1) b1 = tmp[0];
-                if (r >= 2) b2 = tmp[1];
+UserAction KeyDecoder::feed(char c) {
+    switch (state) {
+        case State::ESCAPE:
+            if (c == '[') {
+                state = State::CSI;
+                return UserAction::NONE;
             }
-            if (b1 == '[') {
-                switch (b2) {
-                    case 'A': if (currentDirection != DOWN) return UserAction::UP; break;
-                    case 'B': if (currentDirection != UP) return UserAction::DOWN; break;
-                    case 'C': if (currentDirection != LEFT) return UserAction::RIGHT; break;
-                    case 'D': if (currentDirection != RIGHT) return UserAction::LEFT; break;
-                }
+            if (c == 'O') {
+                state = State::SS3;
+                return UserAction::NONE;
             }
-        } else {
-            if (c == 'q' || c == 'Q') return UserAction::QUIT;
-            if (c == 'p' || c == 'P' || c == ' ') return UserAction::PAUSE;
-            if (c == 'r' || c == 'R') return UserAction::RESTART;
-            if (c == 'd' || c == 'D') return UserAction::CHANGE_DIFFICULTY;
-            if ((c == 'w' || c == 'W') && currentDirection != DOWN) return UserAction::UP;
-            if ((c == 's' || c == 'S') && currentDirection != UP) return UserAction::DOWN;
-            if ((c == 'd' || c == 'D') && currentDirection != LEFT) return UserAction::RIGHT;
-            if ((c == 'a' || c == 'A') && currentDirection != RIGHT) return UserAction::LEFT;
-        }
+            // A lone ESC, the byte after it is a key of its own
+            state = State::GROUND;
+            break;
+        case State::CSI:
+            // Parameters and intermediates (e.g. the modifiers in ESC [ 1 ; 5 A) until the final byte
+            if (c >= 0x20 && c <= 0x3f) return UserAction::NONE;
+            state = State::GROUND;
+            return arrow(c);
+        case State::SS3:
+            state = State::GROUND;
+            return arrow(c);
+        case State::GROUND:
+            break;
+    }
+
+    switch (c) {
+        case '\033': state = State::ESCAPE; return UserAction::NONE;
+        case 'q': case 'Q': return UserAction::QUIT;
+        case 'p': case 'P': case ' ': return UserAction::PAUSE;
+        case 'r': case 'R': return UserAction::RESTART;
+        case 'd': case 'D': return UserAction::CHANGE_DIFFICULTY;
+        case 'w': case 'W': return UserAction::UP;
+        case 's': case 'S': return UserAction::DOWN;
+        case 'a': case 'A': return UserAction::LEFT;
+        default: return UserAction::NONE;
+    }
+}
+
+void Input::readPending() {
+    char buf[64];
+    while (kbhit()) {
+        int n = readBytes(buf, sizeof(buf));
+        if (n == 0) break;
+        feed(buf, n);
+    }
+}
+
+void Input::feed(const char* bytes, int n) {
+    for (int i = 0; i < n; ++i) {
+        UserAction action = decoder.feed(bytes[i]);
+        if (action == UserAction::NONE || count == QUEUE_SIZE) continue;
+        queue[(head + count) % QUEUE_SIZE] = action;
+        count++;
     }
-    return UserAction::NONE;
-}
\ No newline at end of file
+}
+
+UserAction Input::pop() {
+    if (count == 0) return UserAction::NONE;
+    UserAction action = queue[head];
+    head = (head + 1) % QUEUE_SIZE;
+    count--;
+    return action;
+}
+
+bool Input::empty() const {
+    return count == 0;
+}
+
+void Input::clear() {
+    head = 0;
+    count = 0;
+}
@@ -0,0 +1,169 @@
+#include "level.h"
+#include "rng.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using std::string;
+
+bool parseLevel(const string& text, Level& level, string& error) {
+    level = Level();
+    std::vector<string> rows;
+    std::istringstream in(text);
+    string line;
+    bool header = true;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (header && !line.empty() && line[0] == ';') continue;
+        if (header && line.compare(0, 5, "food ") == 0) {
+            level.food_count = atoi(line.c_str() + 5);
+            if (level.food_count < 1) {
+                error = "food count must be at least 1";
+                return false;
+            }
+            continue;
+        }
+        header = false;
+        rows.push_back(line);
+    }
+    while (!rows.empty() && rows.back().empty()) rows.pop_back();
+
+    level.height = (int)rows.size();
+    for (const auto& r : rows) level.width = std::max(level.width, (int)r.size());
+    if (level.width < 4 || level.height < 2) {
+        error = "level must be at least 4x2";
+        return false;
+    }
+
+    bool has_start = false;
+    int first_portal[26];
+    std::fill(first_portal, first_portal + 26, -1);
+    for (int y = 0; y < level.height; ++y) {
+        for (int x = 0; x < (int)rows[y].size(); ++x) {
+            char c = rows[y][x];
+            int cell = y * level.width + x;
+            if (c == '#') {
+                level.obstacles.push_back(cell);
+            } else if (c == 'S') {
+                if (has_start) {
+                    error = "more than one S";
+                    return false;
+                }
+                level.start = {x, y};
+                has_start = true;
+            } else if (c >= 'a' && c <= 'z') {
+                int& first = first_portal[c - 'a'];
+                if (first == -2) {
+                    error = string("portal ") + c + " appears more than twice";
+                    return false;
+                }
+                if (first == -1) {
+                    first = cell;
+                } else {
+                    level.portals.push_back({first, cell});
+                    first = -2;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < 26; ++i) {
+        if (first_portal[i] >= 0) {
+            error = string("portal ") + (char)('a' + i) + " has no partner";
+            return false;
+        }
+    }
+    if (!has_start) {
+        error = "no S to start from";
+        return false;
+    }
+    int sx = level.start.x;
+    int sy = level.start.y;
+    for (int i = 1; i <= 2; ++i) {
+        char c = sx - i >= 0 && sx - i < (int)rows[sy].size() ? rows[sy][sx - i] : '#';
+        if (sx - i < 0 || c == '#' || (c >= 'a' && c <= 'z')) {
+            error = "S needs two open cells to its left for the body";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadLevel(const string& path, Level& level, string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return parseLevel(text, level, error);
+}
+
+Level makeMaze(int width, int height, int food_count, uint64_t seed) {
+    Level level;
+    level.width = width;
+    level.height = height;
+    level.food_count = food_count;
+    std::vector<uint8_t> open((size_t)width * height, 0);
+    Rng rng(seed);
+
+    // Rooms sit on odd coordinates, walls between them are knocked through
+    static const int DX[4] = {0, 0, -2, 2};
+    static const int DY[4] = {-2, 2, 0, 0};
+    std::vector<int> stack;
+    int origin = 1 * width + 1;
+    open[origin] = 1;
+    stack.push_back(origin);
+    while (!stack.empty()) {
+        int c = stack.back();
+        int x = c % width;
+        int y = c / width;
+        int options[4];
+        int count = 0;
+        for (int d = 0; d < 4; ++d) {
+            int nx = x + DX[d];
+            int ny = y + DY[d];
+            if (nx < 1 || nx >= width - 1 || ny < 1 || ny >= height - 1) continue;
+            if (!open[ny * width + nx]) options[count++] = d;
+        }
+        if (count == 0) {
+            stack.pop_back();
+            continue;
+        }
+        int d = options[rng.below(count)];
+        int nx = x + DX[d];
+        int ny = y + DY[d];
+        open[(y + DY[d] / 2) * width + (x + DX[d] / 2)] = 1;
+        open[ny * width + nx] = 1;
+        stack.push_back(ny * width + nx);
+    }
+
+    // A snake can't turn around in a dead end, so every dead end is knocked through to
+    // another room, which also gives the maze loops
+    for (int y = 1; y < height - 1; y += 2) {
+        for (int x = 1; x < width - 1; x += 2) {
+            int walls[4];
+            int closed = 0;
+            int exits = 0;
+            for (int d = 0; d < 4; ++d) {
+                int nx = x + DX[d];
+                int ny = y + DY[d];
+                if (nx < 1 || nx >= width - 1 || ny < 1 || ny >= height - 1) continue;
+                int wall = (y + DY[d] / 2) * width + (x + DX[d] / 2);
+                if (open[wall]) exits++;
+                else walls[closed++] = wall;
+            }
+            if (exits == 1 && closed > 0) open[walls[rng.below(closed)]] = 1;
+        }
+    }
+
+    // The snake starts at the top left, facing along the first corridor
+    open[1 * width + 2] = 1;
+    open[1 * width + 3] = 1;
+    level.start = {3, 1};
+    for (int i = 0; i < width * height; ++i) {
+        if (!open[i]) level.obstacles.push_back(i);
+    }
+    return level;
+}
@@ -1,15 +1,106 @@
 #include "game.h"
 #include "terminal.h"
 #include "render.h"
+#include "tick_timer.h"
+#include "autopilot.h"
+#include "replay.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
-#include <thread>
+#include <poll.h>
+#include <signal.h>
+#include <string>
+#include <unistd.h>
+
+// Ticks run per frame at most; beyond that the game is suspended or hopelessly behind and
+// the missed time is dropped instead of fast-forwarded
+static const int MAX_CATCH_UP = 8;
+
+int main(int argc, char** argv) {
+    bool autopilot = false;
+    int fps = 60;
+    int world_width = 0;
+    int world_height = 0;
+    bool hud = false;
+    bool has_level = false;
+    Level level;
+    std::string record_path = replayPath();
+    std::string stats_path;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--auto")) {
+            autopilot = true;
+        } else if (!strcmp(argv[i], "--hud")) {
+            hud = true;
+        } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (!strcmp(argv[i], "--stats") && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (!strcmp(argv[i], "--fps") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            fps = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--world") && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%dx%d", &world_width, &world_height) == 2 && world_width >= 10 &&
+                   world_height >= 5 && (int64_t)world_width * world_height < INT32_MAX) {
+            ++i;
+        } else if (!strcmp(argv[i], "--level") && i + 1 < argc) {
+            std::string error;
+            if (!loadLevel(argv[++i], level, error)) {
+                std::cerr << argv[i] << ": " << error << "\n";
+                return 1;
+            }
+            // A level is a fixed world of its own, shown through a window when it doesn't fit
+            has_level = true;
+            world_width = level.width;
+            world_height = level.height;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--auto] [--hud] [--fps N] [--world WxH | --level FILE] [--record replay-file] [--stats out.json]\n"
+                      << "  The screen is redrawn up to N times a second (default 60), independent of game speed\n"
+                      << "  --world plays on a WxH board larger than the screen, which scrolls to follow the head\n"
+                      << "  --level plays a level file with obstacles, portals and several foods (see include/level.h)\n"
+                      << "  Every session is recorded, by default to " << replayPath() << "\n"
+                      << "  --hud shows tick, draw, frame size, timer lateness and key-to-draw latency (p50/p99),\n"
+                      << "  --stats writes the full histograms as JSON on exit\n";
+            return 1;
+        }
+    }
+
+    if (autopilot && (int64_t)world_width * world_height > Board::DENSE_MAX_CELLS) {
+        std::cerr << "--auto plans over the whole board and needs a world of at most " << Board::DENSE_MAX_CELLS
+                  << " cells.\n";
+        return 1;
+    }
 
-int main() {
     Terminal term;
-    int choice = promptDifficulty();
+    int choice = promptDifficulty(term);
+    if (choice < 0) return 0;
     term.enableRawMode();
+    bool sync_updates = term.supportsSyncUpdates();
+    size_t frame_bytes = 0;
+    size_t frame_count = 0;
+    bool quit = false;
+    bool instrument = hud || !stats_path.empty();
+    LoopStats stats;
+    uint64_t key_ns = 0;
+    uint64_t hud_ns = 0;
+    int frame_ms = std::max(1, 1000 / fps);
+
+    TickTimer timer;
+    Input input;
+    Autopilot pilot;
+    ReplayRecorder recorder;
+    Rng seeds((uint64_t)time(nullptr) ^ ((uint64_t)getpid() << 32));
+    // Everything the loop waits on: keys, the tick timer and SIGWINCH/SIGINT/SIGTERM
+    pollfd fds[3] = {
+        {STDIN_FILENO, POLLIN, 0},
+        {timer.fd(), POLLIN, 0},
+        {term.signalFd(), POLLIN, 0},
+    };
 
-    while (true) {
+    while (!quit) {
         int width, height;
         term.getWindowSize(width, height);
         int game_width = (width / 2) - 2;
@@ -20,57 +111,172 @@ int main() {
             return 1;
         }
 
-        Game game(game_width, game_height, choice);
-        Renderer renderer(game_width, game_height);
-        Input input;
-
-        while (!game.isGameOver()) {
-            if (Terminal::isResized()) {
-                Terminal::setResized(false);
-                term.getWindowSize(width, height);
-                game_width = (width / 2) - 2;
-                game_height = height - 3;
-                game.resize(game_width, game_height);
-                renderer.resize(game_width, game_height);
+        Game game = has_level     ? Game(level, choice)
+                    : world_width ? Game(world_width, world_height, choice)
+                                  : Game(game_width, game_height, choice);
+        recorder.start(game);
+        Renderer renderer(std::min(game_width, game.getBoard().getWidth()), std::min(game_height, game.getBoard().getHeight()));
+        if (world_width) {
+            renderer.setWorld(world_width, world_height);
+            game.setPaceWidth(game_width);
+        }
+        renderer.setSyncUpdates(sync_updates);
+        renderer.draw(game);
+        // Simulated time owed since the last frame, paid off in whole ticks
+        uint64_t behind = 0;
+        uint64_t last_frame = monotonicNs();
+        timer.start(frame_ms);
+
+        while (!game.isGameOver() && !quit) {
+            if (poll(fds, 3, -1) < 0) continue;
+
+            if (fds[2].revents & POLLIN) {
+                int sig = term.readSignal();
+                if (sig == SIGWINCH) {
+                    term.getWindowSize(width, height);
+                    game_width = (width / 2) - 2;
+                    game_height = height - 3;
+                    if (world_width) {
+                        // The world doesn't depend on the screen, only the window changes
+                        game_width = std::max(1, std::min(game_width, world_width));
+                        game_height = std::max(1, std::min(game_height, world_height));
+                        game.setPaceWidth(game_width);
+                        renderer.resize(game_width, game_height);
+                        renderer.present(game);
+                        continue;
+                    }
+                    // A resize starts over, so start the recording over too
+                    game.reseed(((uint64_t)seeds.next() << 32) | seeds.next());
+                    game.resize(game_width, game_height);
+                    recorder.start(game);
+                    key_ns = 0;
+                    renderer.resize(game_width, game_height);
+                    renderer.draw(game);
+                    // resize resets the game, which unpauses it
+                    behind = 0;
+                    last_frame = monotonicNs();
+                    timer.start(frame_ms);
+                } else if (sig == SIGINT || sig == SIGTERM) {
+                    quit = true;
+                }
+            }
+
+            if (fds[0].revents & POLLIN) {
+                bool was_paused = game.isPaused();
+                if (instrument && !key_ns) key_ns = monotonicNs();
+                game.processInput(&input);
+                if (game.isPaused() != was_paused) {
+                    key_ns = 0;
+                    if (game.isPaused()) {
+                        timer.stop();
+                        renderer.drawPaused();
+                    } else {
+                        renderer.clearMessage();
+                        behind = 0;
+                        last_frame = monotonicNs();
+                        timer.start(frame_ms);
+                    }
+                }
             }
 
-            game.processInput(&input);
-            game.update();
-            renderer.draw(game.getSnake(), game.getFood(), game.getScore(), game.getHighscore());
-            if(game.isPaused()) {
-                renderer.drawPaused();
+            // A pause or resize handled above may have disarmed the timer that woke us
+            if ((fds[1].revents & POLLIN) && timer.consume() > 0) {
+                uint64_t now = monotonicNs();
+                if (instrument) stats.jitter_ns.record(timer.lateNs());
+                behind += now - last_frame;
+                last_frame = now;
+
+                // Fixed timestep: run every tick that has come due, then draw once. A slow
+                // frame only means more ticks before the next one, so the terminal drops
+                // frames rather than slowing the game.
+                uint64_t tick_ns = (uint64_t)game.computeTickMs() * 1000000ULL;
+                int steps = 0;
+                while (behind >= tick_ns && steps < MAX_CATCH_UP && !game.isGameOver()) {
+                    if (autopilot) game.setDirection(pilot.choose(game));
+                    recorder.beforeStep(game);
+                    uint64_t t0 = instrument ? monotonicNs() : 0;
+                    game.step();
+                    if (instrument) stats.tick_ns.record(monotonicNs() - t0);
+                    renderer.capture(game);
+                    behind -= tick_ns;
+                    tick_ns = (uint64_t)game.computeTickMs() * 1000000ULL;
+                    steps++;
+                }
+                if (behind >= tick_ns) behind = 0;
+
+                if (steps > 0) {
+                    uint64_t t1 = instrument ? monotonicNs() : 0;
+                    // Refreshed a few times a second so the overlay itself costs almost nothing
+                    if (hud && t1 - hud_ns > 250000000ULL) {
+                        renderer.setOverlay(stats.hudLine());
+                        hud_ns = t1;
+                    }
+                    renderer.present(game);
+                    if (instrument) {
+                        uint64_t t2 = monotonicNs();
+                        stats.render_ns.record(t2 - t1);
+                        stats.frame_bytes.record(renderer.getLastFrameBytes());
+                        if (key_ns) stats.key_to_draw_ns.record(t2 - key_ns);
+                        key_ns = 0;
+                    }
+                }
+
+                // Missed a whole frame: start the cadence over instead of firing back to back
+                if (timer.lateNs() > (uint64_t)frame_ms * 1000000ULL) timer.start(frame_ms);
+                else timer.schedule(frame_ms);
             }
         }
+        timer.stop();
+        saveReplay(recorder.finish(game), record_path);
 
         if (game.getScore() > loadHighscore()) {
             saveHighscore(game.getScore());
         }
+        frame_bytes += renderer.getTotalBytes();
+        frame_count += renderer.getFrameCount();
+        if (quit) break;
         renderer.drawGameOver(game.getScore());
 
-        bool quit = false;
-        while (!quit) {
-            UserAction action = input.getUserAction(RIGHT); // direction doesn't matter here
-            switch (action) {
-                case UserAction::QUIT:
-                    quit = true;
-                    break;
-                case UserAction::RESTART:
-                    goto next_game;
-                case UserAction::CHANGE_DIFFICULTY:
-                    term.disableRawMode();
-                    choice = promptDifficulty();
-                    term.enableRawMode();
-                    goto next_game;
-                default:
-                    break;
+        bool next_game = false;
+        while (!next_game && !quit) {
+            if (poll(fds, 3, -1) < 0) continue;
+
+            if (fds[2].revents & POLLIN) {
+                int sig = term.readSignal();
+                if (sig == SIGINT || sig == SIGTERM) quit = true;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(30));
-        }
-        if (quit) break;
 
-    next_game:;
+            if (!(fds[0].revents & POLLIN)) continue;
+            input.readPending();
+            UserAction action;
+            while (!next_game && !quit && (action = input.pop()) != UserAction::NONE) {
+                switch (action) {
+                    case UserAction::QUIT:
+                        quit = true;
+                        break;
+                    case UserAction::RESTART:
+                        next_game = true;
+                        break;
+                    case UserAction::CHANGE_DIFFICULTY:
+                        term.disableRawMode();
+                        choice = promptDifficulty(term);
+                        term.enableRawMode();
+                        // The prompt read its own line, anything queued before it is stale
+                        input.clear();
+                        if (choice < 0) quit = true;
+                        next_game = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
     }
 
+    if (!stats_path.empty() && !stats.save(stats_path)) std::cerr << "Could not write " << stats_path << "\n";
     std::cout << "\nThanks for playing.\n";
+    if (frame_count > 0) {
+        std::cout << "Average frame: " << frame_bytes / frame_count << " bytes over " << frame_count << " frames.\n";
+    }
     return 0;
 }
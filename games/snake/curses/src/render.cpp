@@ -1,37 +1,77 @@
 #include "render.h"
-#include <iostream>
+#include <algorithm>
+#include <unistd.h>
 
-using std::string;
-using std::deque;
-using std::cout;
-using std::flush;
+static const char* const HEAD_COLOR = "\033[1;32m";
+static const char* const BODY_COLOR = "\033[0;32m";
+static const char* const FOOD_COLOR = "\033[1;31m";
+static const char* const OBSTACLE_COLOR = "\033[0;37m";
+static const char* const PORTAL_COLOR = "\033[1;35m";
+static const char* const RESET_COLOR = "\033[0m";
+static const char* const BLOCK = "██";
 
-Renderer::Renderer(int width, int height) : width(width), height(height), last_food(-1, -1), last_score(-1), last_highscore(-1) {
+Renderer::Renderer(int width, int height, int out_fd)
+    : width(width),
+      height(height),
+      world_width(0),
+      world_height(0),
+      cam_x(0),
+      cam_y(0),
+      full_redraw(true),
+      sync_updates(false),
+      out_fd(out_fd),
+      last_score(-1),
+      last_highscore(-1),
+      overlay_dirty(false),
+      last_frame_bytes(0),
+      total_bytes(0),
+      frame_count(0) {
     drawBorder();
 }
 
-void Renderer::moveCursor(int row, int col) {
-    cout << "\033[" << row << ";" << col << "H";
+void Renderer::beginFrame() {
+    frame.clear();
+    if (sync_updates) frame.append("\033[?2026h");
 }
 
-void Renderer::drawCell(const Point& p, const string &color) {
-    int row = p.y + WALL_OFFSET_Y;
-    int col = p.x * CELL_W + WALL_OFFSET_X;
-    cout << "\033[" << row << ";" << col << "H" << color << "██" << "\033[0m";
+void Renderer::endFrame() {
+    if (sync_updates) frame.append("\033[?2026l");
+    if (out_fd >= 0) {
+        last_frame_bytes = frame.flush(out_fd);
+    } else {
+        last_frame_bytes = frame.size();
+        frame.clear();
+    }
+    total_bytes += last_frame_bytes;
+    frame_count++;
+}
+
+void Renderer::drawCell(const Point& p, const char* color) {
+    int x = p.x - cam_x;
+    int y = p.y - cam_y;
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    frame.moveCursor(y + WALL_OFFSET_Y, x * CELL_W + WALL_OFFSET_X);
+    frame.append(color);
+    frame.append(BLOCK);
+    frame.append(RESET_COLOR);
 }
 
 void Renderer::clearCell(const Point& p) {
-    int row = p.y + WALL_OFFSET_Y;
-    int col = p.x * CELL_W + WALL_OFFSET_X;
-    cout << "\033[" << row << ";" << col << "H" << "  ";
+    int x = p.x - cam_x;
+    int y = p.y - cam_y;
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    frame.moveCursor(y + WALL_OFFSET_Y, x * CELL_W + WALL_OFFSET_X);
+    frame.append("  ", 2);
 }
 
-void Renderer::drawText(int row, int col, const string &s) {
-    cout << "\033[" << row << ";" << col << "H" << s;
+void Renderer::drawText(int row, int col, const char* s) {
+    frame.moveCursor(row, col);
+    frame.append(s);
 }
 
 void Renderer::drawBorder() {
-    cout << "\033[2J";
+    beginFrame();
+    frame.append("\033[2J");
     const int top_y = 1;
     const int bottom_y = height + 2;
     const int left_x = 1;
@@ -39,72 +79,211 @@ void Renderer::drawBorder() {
 
     // Top and bottom borders
     for (int x = left_x; x <= right_x; x += 2) {
-        cout << "\033[" << top_y << ";" << x << "H██";
-        cout << "\033[" << bottom_y << ";" << x << "H██";
+        drawText(top_y, x, BLOCK);
+        drawText(bottom_y, x, BLOCK);
     }
 
     // Left and right borders
     for (int y = top_y + 1; y < bottom_y; ++y) {
-        cout << "\033[" << y << ";" << left_x << "H██";
-        cout << "\033[" << y << ";" << right_x << "H██";
+        drawText(y, left_x, BLOCK);
+        drawText(y, right_x, BLOCK);
     }
+    endFrame();
 }
 
-void Renderer::draw(const deque<Point>& snake, const Point& food, int score, int highscore) {
-    for (const auto& p : last_snake) {
-        bool found = false;
-        for (const auto& p2 : snake) {
-            if (p == p2) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            clearCell(p);
+void Renderer::drawFull(const Game& game) {
+    if (world_width) {
+        drawWindow(game);
+        return;
+    }
+    if (const Level* level = game.getLevel()) {
+        for (int cell : level->obstacles) drawCell({cell % level->width, cell / level->width}, OBSTACLE_COLOR);
+        for (const auto& pair : level->portals) {
+            drawCell({pair.first % level->width, pair.first / level->width}, PORTAL_COLOR);
+            drawCell({pair.second % level->width, pair.second / level->width}, PORTAL_COLOR);
         }
     }
-
+    const auto& snake = game.getSnake();
     if (!snake.empty()) {
-        drawCell(snake.front(), "\033[1;32m");
-        for (size_t i = 1; i < snake.size(); ++i) drawCell(snake[i], "\033[0;32m");
+        drawCell(snake.front(), HEAD_COLOR);
+        for (size_t i = 1; i < snake.size(); ++i) drawCell(snake[i], BODY_COLOR);
+    }
+    for (const auto& food : game.getFoods()) {
+        if (food.x >= 0) drawCell(food, FOOD_COLOR);
     }
-    if (food.x >= 0) {
-        if (last_food.x != food.x || last_food.y != food.y) {
-            clearCell(last_food);
-            drawCell(food, "\033[1;31m");
+}
+
+// Repaints every visible cell from the board, blanks included, since scrolling leaves the
+// previous window on screen. Costs the window area however long the snake is.
+void Renderer::drawWindow(const Game& game) {
+    const Board& board = game.getBoard();
+    const Point head = game.getSnake().empty() ? Point(-1, -1) : game.getSnake().front();
+    for (int y = 0; y < height; ++y) {
+        int wy = cam_y + y;
+        frame.moveCursor(y + WALL_OFFSET_Y, WALL_OFFSET_X);
+        for (int x = 0; x < width; ++x) {
+            int wx = cam_x + x;
+            const char* color = nullptr;
+            if (!board.isFree(wx, wy)) {
+                if (wx == head.x && wy == head.y) color = HEAD_COLOR;
+                else if (game.isObstacle(wx, wy)) color = OBSTACLE_COLOR;
+                else if (game.isPortal(wx, wy)) color = PORTAL_COLOR;
+                else color = BODY_COLOR;
+            }
+            if (!color) {
+                frame.append("  ", 2);
+                continue;
+            }
+            frame.append(color);
+            frame.append(BLOCK);
+            frame.append(RESET_COLOR);
         }
     }
+    // Food cells are free on the board, drawCell skips the ones outside the window
+    for (const auto& food : game.getFoods()) {
+        if (food.x >= 0) drawCell(food, FOOD_COLOR);
+    }
+
+    // Where the window is, written over the top border
+    drawText(1, WALL_OFFSET_X, " ");
+    frame.appendInt(cam_x);
+    frame.append(",");
+    frame.appendInt(cam_y);
+    frame.append(" of ");
+    frame.appendInt(world_width);
+    frame.append("x");
+    frame.appendInt(world_height);
+    frame.append(" ");
+}
+
+// Recentres on the head once it comes within a quarter window of an edge, clamped to the
+// world. Returns true when the window moved.
+bool Renderer::followHead(const Game& game) {
+    if (game.getSnake().empty()) return false;
+    Point head = game.getSnake().front();
+    int nx = cam_x;
+    int ny = cam_y;
+    if (head.x < cam_x + width / 4 || head.x >= cam_x + width - width / 4) nx = head.x - width / 2;
+    if (head.y < cam_y + height / 4 || head.y >= cam_y + height - height / 4) ny = head.y - height / 2;
+    nx = std::max(0, std::min(nx, world_width - width));
+    ny = std::max(0, std::min(ny, world_height - height));
+    if (nx == cam_x && ny == cam_y) return false;
+    cam_x = nx;
+    cam_y = ny;
+    return true;
+}
+
+void Renderer::drawChange(const CellChange& c) {
+    switch (c.kind) {
+        case CellKind::EMPTY: clearCell(c.p); break;
+        case CellKind::HEAD: drawCell(c.p, HEAD_COLOR); break;
+        case CellKind::BODY: drawCell(c.p, BODY_COLOR); break;
+        case CellKind::FOOD: drawCell(c.p, FOOD_COLOR); break;
+    }
+}
+
+void Renderer::draw(const Game& game) {
+    capture(game);
+    present(game);
+}
+
+void Renderer::capture(const Game& game) {
+    const auto& changes = game.getChanges();
+    pending.insert(pending.end(), changes.begin(), changes.end());
+}
+
+void Renderer::present(const Game& game) {
+    if (world_width && followHead(game)) full_redraw = true;
+    beginFrame();
+    // Only the cells touched since the last frame are repainted, in tick order so the
+    // latest state of a cell wins, unless the screen was wiped
+    if (full_redraw) {
+        drawFull(game);
+        full_redraw = false;
+    } else {
+        for (const auto& c : pending) drawChange(c);
+    }
+    pending.clear();
+
+    int score = game.getScore();
+    int highscore = game.getHighscore();
     if (score != last_score || highscore != last_highscore) {
-        drawText(height + WALL_OFFSET_Y + 2, 1, "Score: " + std::to_string(score) + "    High: " + std::to_string(highscore) + "    ");
+        drawText(height + WALL_OFFSET_Y + 2, 1, "Score: ");
+        frame.appendInt(score);
+        frame.append("    High: ");
+        frame.appendInt(highscore);
+        frame.append("    ");
         last_score = score;
         last_highscore = highscore;
     }
-    cout << flush;
-    last_snake = snake;
-    last_food = food;
+    if (overlay_dirty) {
+        drawText(height + WALL_OFFSET_Y + 2, OVERLAY_COL, overlay.c_str());
+        frame.append("\033[K");
+        overlay_dirty = false;
+    }
+    endFrame();
 }
 
 void Renderer::drawGameOver(int score) {
-    drawText(height + WALL_OFFSET_Y + 3, 1, "Game Over! Score: " + std::to_string(score) + "    ");
+    beginFrame();
+    drawText(height + WALL_OFFSET_Y + 3, 1, "Game Over! Score: ");
+    frame.appendInt(score);
+    frame.append("    ");
     drawText(height + WALL_OFFSET_Y + 4, 1, "Press 'r' to restart, 'd' to choose difficulty, or 'q' to quit.");
-    cout << flush;
+    endFrame();
 }
 
 void Renderer::drawPaused() {
+    beginFrame();
     drawText(height + WALL_OFFSET_Y + 3, 1, "PAUSED - press 'p' to resume.               ");
-    cout << flush;
+    endFrame();
 }
 
 void Renderer::clearMessage() {
-    drawText(height + WALL_OFFSET_Y + 3, 1, string(80, ' '));
-    drawText(height + WALL_OFFSET_Y + 4, 1, string(80, ' '));
-    cout << flush;
+    static const char blank[] =
+        "                                                                                ";
+    beginFrame();
+    drawText(height + WALL_OFFSET_Y + 3, 1, blank);
+    drawText(height + WALL_OFFSET_Y + 4, 1, blank);
+    endFrame();
 }
 
 void Renderer::resize(int new_width, int new_height) {
     width = new_width;
     height = new_height;
-    last_snake.clear();
-    last_food = {-1, -1};
+    full_redraw = true;
+    overlay_dirty = !overlay.empty();
+    last_score = -1;
+    last_highscore = -1;
     drawBorder();
 }
+
+void Renderer::setSyncUpdates(bool enabled) {
+    sync_updates = enabled;
+}
+
+void Renderer::setWorld(int new_world_width, int new_world_height) {
+    world_width = new_world_width;
+    world_height = new_world_height;
+    cam_x = 0;
+    cam_y = 0;
+    full_redraw = true;
+}
+
+void Renderer::setOverlay(const std::string& text) {
+    if (text == overlay) return;
+    overlay = text;
+    overlay_dirty = true;
+}
+
+size_t Renderer::getLastFrameBytes() const {
+    return last_frame_bytes;
+}
+
+size_t Renderer::getTotalBytes() const {
+    return total_bytes;
+}
+
+size_t Renderer::getFrameCount() const {
+    return frame_count;
+}
@@ -0,0 +1,191 @@
+#include "replay.h"
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+using std::string;
+
+static const char MAGIC[4] = {'S', 'N', 'K', 'R'};
+static const uint8_t VERSION = 2;
+
+static void putVarint(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static bool getVarint(const string& in, size_t& pos, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        uint8_t b = (uint8_t)in[pos++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+void ReplayRecorder::start(const Game& game) {
+    replay = Replay();
+    replay.seed = game.getSeed();
+    replay.difficulty = game.getDifficulty();
+    replay.width = game.getBoard().getWidth();
+    replay.height = game.getBoard().getHeight();
+    if (const Level* level = game.getLevel()) {
+        replay.has_level = true;
+        replay.level = *level;
+    }
+    last_dir = game.getDirection();
+}
+
+void ReplayRecorder::beforeStep(const Game& game) {
+    if (game.nextDirection() == last_dir) return;
+    last_dir = game.nextDirection();
+    replay.turns.push_back({game.getTicks(), last_dir});
+}
+
+const Replay& ReplayRecorder::finish(const Game& game) {
+    replay.end_tick = game.getTicks();
+    return replay;
+}
+
+string encodeReplay(const Replay& replay) {
+    string out(MAGIC, sizeof(MAGIC));
+    out.push_back((char)VERSION);
+    putVarint(out, replay.seed);
+    putVarint(out, replay.difficulty);
+    putVarint(out, replay.width);
+    putVarint(out, replay.height);
+    putVarint(out, replay.end_tick);
+    putVarint(out, replay.turns.size());
+    uint64_t prev = 0;
+    for (const auto& t : replay.turns) {
+        putVarint(out, ((t.tick - prev) << 2) | (uint64_t)t.dir);
+        prev = t.tick;
+    }
+    putVarint(out, replay.has_level);
+    if (replay.has_level) {
+        const Level& level = replay.level;
+        putVarint(out, level.food_count);
+        putVarint(out, level.start.x);
+        putVarint(out, level.start.y);
+        // Obstacles are sorted, so the gaps between them stay small
+        putVarint(out, level.obstacles.size());
+        int prev_cell = 0;
+        for (int cell : level.obstacles) {
+            putVarint(out, cell - prev_cell);
+            prev_cell = cell;
+        }
+        putVarint(out, level.portals.size());
+        for (const auto& pair : level.portals) {
+            putVarint(out, pair.first);
+            putVarint(out, pair.second);
+        }
+    }
+    return out;
+}
+
+static bool decodeLevel(const string& data, size_t& pos, int width, int height, Level& level) {
+    uint64_t cells = (uint64_t)width * height;
+    uint64_t food_count, sx, sy, count;
+    if (!getVarint(data, pos, food_count) || !getVarint(data, pos, sx) || !getVarint(data, pos, sy) ||
+        !getVarint(data, pos, count)) {
+        return false;
+    }
+    if (food_count == 0 || food_count > cells || sx < 2 || sx >= (uint64_t)width || sy >= (uint64_t)height || count > cells) {
+        return false;
+    }
+    level = Level();
+    level.width = width;
+    level.height = height;
+    level.food_count = (int)food_count;
+    level.start = {(int)sx, (int)sy};
+    uint64_t cell = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t gap;
+        if (!getVarint(data, pos, gap)) return false;
+        cell += gap;
+        if (cell >= cells) return false;
+        level.obstacles.push_back((int)cell);
+    }
+    if (!getVarint(data, pos, count) || count > 26) return false;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t a, b;
+        if (!getVarint(data, pos, a) || !getVarint(data, pos, b) || a >= cells || b >= cells) return false;
+        level.portals.push_back({(int)a, (int)b});
+    }
+    return true;
+}
+
+bool decodeReplay(const string& data, Replay& replay) {
+    if (data.size() < sizeof(MAGIC) + 1 || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) return false;
+    uint8_t version = (uint8_t)data[sizeof(MAGIC)];
+    if (version < 1 || version > VERSION) return false;
+    size_t pos = sizeof(MAGIC) + 1;
+    uint64_t diff, width, height, count;
+    if (!getVarint(data, pos, replay.seed) || !getVarint(data, pos, diff) || !getVarint(data, pos, width) ||
+        !getVarint(data, pos, height) || !getVarint(data, pos, replay.end_tick) || !getVarint(data, pos, count)) {
+        return false;
+    }
+    // Same limit as --world; each side is bounded first so the product can't wrap
+    if (diff >= DIFFICULTIES.size() || width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX ||
+        width * height >= INT32_MAX) {
+        return false;
+    }
+    replay.difficulty = (int)diff;
+    replay.width = (int)width;
+    replay.height = (int)height;
+    replay.turns.clear();
+    uint64_t tick = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t packed;
+        if (!getVarint(data, pos, packed)) return false;
+        tick += packed >> 2;
+        replay.turns.push_back({tick, (Direction)(packed & 3)});
+    }
+    replay.has_level = false;
+    if (version >= 2) {
+        uint64_t has_level;
+        if (!getVarint(data, pos, has_level)) return false;
+        if (has_level && !decodeLevel(data, pos, replay.width, replay.height, replay.level)) return false;
+        replay.has_level = has_level != 0;
+    }
+    return pos == data.size();
+}
+
+bool saveReplay(const Replay& replay, const string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    string data = encodeReplay(replay);
+    out.write(data.data(), data.size());
+    return (bool)out;
+}
+
+bool loadReplay(const string& path, Replay& replay) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return decodeReplay(data, replay);
+}
+
+string replayPath() {
+    const char* home = getenv("HOME");
+    if (!home) home = ".";
+    return string(home) + "/.snake_last_replay";
+}
+
+Game playReplay(const Replay& replay, const std::function<void(const Game&)>& on_tick) {
+    Game game = replay.has_level ? Game(replay.level, replay.difficulty, replay.seed)
+                                 : Game(replay.width, replay.height, replay.difficulty, replay.seed);
+    size_t next = 0;
+    while (!game.isGameOver() && game.getTicks() < replay.end_tick) {
+        while (next < replay.turns.size() && replay.turns[next].tick == game.getTicks()) {
+            game.setDirection(replay.turns[next++].dir);
+        }
+        game.step();
+        if (on_tick) on_tick(game);
+    }
+    return game;
+}
@@ -0,0 +1,498 @@
+#include "arena.h"
+#include "game.h"
+#include "rng.h"
+#include "stats.h"
+#include "tick_timer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+
+// A client further behind than this is dropped rather than buffered for
+static const size_t MAX_BACKLOG = 256 * 1024;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void onSignal(int) {
+    stop_requested = 1;
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " (--unix PATH | --tcp PORT) [--size WxH] [--bots N] [--food N] [--tick-ms MS]\n"
+              << "                   [--seed S] [--seconds S]\n"
+              << "       " << prog << " --connect (--unix PATH | --tcp PORT) --clients N [--seconds S]\n"
+              << "  Runs one authoritative tick over a shared board, Insane speed by default, and prints\n"
+              << "  per-second tick cost so you can see how many snakes one core sustains. --connect opens\n"
+              << "  N clients that turn at random, for load testing a server.\n"
+              << "  Every message is a varint length and a type byte. On connect the server sends\n"
+              << "  'W' width height id tick-ms and 'F' tick count cells..., then 'D' tick count cells...\n"
+              << "  deaths ids... every tick, where a cell is varint (index << 2 | kind) followed by the owner\n"
+              << "  id for heads, kind being 0 empty, 1 head, 2 body, 3 food. Clients send one byte per turn:\n"
+              << "  0 up, 1 down, 2 left, 3 right.\n";
+}
+
+static void putVarint(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+// Messages are built after a reserved length byte and the length patched in once known
+static size_t beginMessage(string& out, char type) {
+    size_t start = out.size();
+    out.push_back(0);
+    out.push_back(type);
+    return start;
+}
+
+static void endMessage(string& out, size_t start) {
+    string len;
+    putVarint(len, out.size() - start - 1);
+    out.replace(start, 1, len);
+}
+
+static void putCell(string& out, uint32_t cell, CellKind kind, int owner) {
+    putVarint(out, ((uint64_t)cell << 2) | (uint64_t)kind);
+    if (kind == CellKind::HEAD) putVarint(out, (uint64_t)owner);
+}
+
+static void encodeDelta(const Arena& arena, string& out) {
+    size_t start = beginMessage(out, 'D');
+    putVarint(out, arena.getTicks());
+    putVarint(out, arena.getChanges().size());
+    for (const auto& c : arena.getChanges()) putCell(out, c.cell, c.kind, c.owner);
+    putVarint(out, arena.getDeaths().size());
+    for (int id : arena.getDeaths()) putVarint(out, (uint64_t)id);
+    endMessage(out, start);
+}
+
+static void encodeFull(const Arena& arena, string& out) {
+    size_t start = beginMessage(out, 'F');
+    putVarint(out, arena.getTicks());
+    size_t cells = 0;
+    for (const auto& s : arena.getSnakes()) cells += s.alive ? s.body.size() : 0;
+    for (int32_t f : arena.getFood()) cells += f >= 0;
+    putVarint(out, cells);
+    const auto& snakes = arena.getSnakes();
+    for (size_t id = 0; id < snakes.size(); ++id) {
+        if (!snakes[id].alive) continue;
+        const SnakeBody& body = snakes[id].body;
+        putCell(out, body.cellAt(0), CellKind::HEAD, (int)id);
+        for (size_t i = 1; i < body.size(); ++i) putCell(out, body.cellAt(i), CellKind::BODY, -1);
+    }
+    for (int32_t f : arena.getFood()) {
+        if (f >= 0) putCell(out, (uint32_t)f, CellKind::FOOD, -1);
+    }
+    endMessage(out, start);
+}
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+struct Address {
+    string unix_path;
+    int tcp_port = 0;
+};
+
+static int openListener(const Address& addr) {
+    int fd;
+    if (!addr.unix_path.empty()) {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        sockaddr_un sa = {};
+        sa.sun_family = AF_UNIX;
+        strncpy(sa.sun_path, addr.unix_path.c_str(), sizeof(sa.sun_path) - 1);
+        // Only a stale socket from an earlier run is removed, a mistyped path to any other
+        // file makes bind fail instead
+        struct stat st;
+        if (lstat(addr.unix_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(addr.unix_path.c_str());
+        if (bind(fd, (sockaddr*)&sa, sizeof(sa)) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in sa = {};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)addr.tcp_port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (sockaddr*)&sa, sizeof(sa)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, 512) < 0 || !setNonBlocking(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int connectTo(const Address& addr) {
+    int fd;
+    int rc;
+    if (!addr.unix_path.empty()) {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un sa = {};
+        sa.sun_family = AF_UNIX;
+        strncpy(sa.sun_path, addr.unix_path.c_str(), sizeof(sa.sun_path) - 1);
+        rc = fd < 0 ? -1 : connect(fd, (sockaddr*)&sa, sizeof(sa));
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in sa = {};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)addr.tcp_port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        rc = fd < 0 ? -1 : connect(fd, (sockaddr*)&sa, sizeof(sa));
+        int one = 1;
+        if (rc == 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (rc < 0 || !setNonBlocking(fd)) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct Client {
+    int fd;
+    int snake;
+    string out;
+    size_t sent = 0;
+};
+
+// Writes as much of the backlog as the socket takes, false if the client should be dropped
+static bool flushClient(Client& c) {
+    while (c.sent < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c.sent += (size_t)n;
+    }
+    if (c.sent == c.out.size()) {
+        c.out.clear();
+        c.sent = 0;
+    }
+    return c.out.size() - c.sent <= MAX_BACKLOG;
+}
+
+// Bots head for their own food item and take any free step, cheap enough for thousands
+static Direction steerBot(const Arena& arena, int id) {
+    static const int DX[4] = {0, 0, -1, 1};
+    static const int DY[4] = {-1, 1, 0, 0};
+    const Arena::Snake& s = arena.getSnakes()[id];
+    const auto& food = arena.getFood();
+    Point head = s.body.front();
+    int32_t target = food.empty() ? -1 : food[id % food.size()];
+    int tx = target >= 0 ? target % arena.getWidth() : head.x;
+    int ty = target >= 0 ? target / arena.getWidth() : head.y;
+    Direction best = s.dir;
+    int best_dist = -1;
+    for (int d = 0; d < 4; ++d) {
+        if ((d ^ 1) == s.dir) continue;
+        int nx = head.x + DX[d];
+        int ny = head.y + DY[d];
+        if (!arena.getBoard().inBounds(nx, ny) || !arena.getBoard().isFree(nx, ny)) continue;
+        int dist = std::abs(nx - tx) + std::abs(ny - ty);
+        if (best_dist < 0 || dist < best_dist) {
+            best = (Direction)d;
+            best_dist = dist;
+        }
+    }
+    return best;
+}
+
+static int runServer(const Address& addr, int width, int height, int bots, int food, int tick_ms, uint64_t seed,
+                     int seconds) {
+    int listener = openListener(addr);
+    if (listener < 0) {
+        perror("listen");
+        return 1;
+    }
+    Arena arena(width, height, food, seed);
+    std::vector<int> bot_ids;
+    for (int i = 0; i < bots; ++i) bot_ids.push_back(arena.join());
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    TickTimer timer;
+    timer.start(tick_ms);
+
+    uint64_t tick_ns = (uint64_t)tick_ms * 1000000ULL;
+    Histogram tick_cost, second_cost;
+    uint64_t overruns = 0, second_overruns = 0;
+    uint64_t bytes = 0, second_bytes = 0, second_ticks = 0;
+    uint64_t started = monotonicNs();
+    uint64_t next_report = started + 1000000000ULL;
+    std::cout << "board " << width << "x" << height << ", tick " << tick_ms << " ms, " << bots << " bots, listening on "
+              << (addr.unix_path.empty() ? "127.0.0.1:" + std::to_string(addr.tcp_port) : addr.unix_path) << "\n";
+
+    string welcome;
+    string delta;
+    char buf[256];
+    while (!stop_requested) {
+        fds.clear();
+        fds.push_back({listener, POLLIN, 0});
+        fds.push_back({timer.fd(), POLLIN, 0});
+        for (const auto& c : clients) fds.push_back({c.fd, (short)(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0});
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;
+
+        // Inputs and backlogs first, walking backwards so dropping a client keeps indices valid
+        for (size_t i = clients.size(); i-- > 0;) {
+            short ev = fds[i + 2].revents;
+            Client& c = clients[i];
+            bool drop = false;
+            if (ev & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n = read(c.fd, buf, sizeof(buf));
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) drop = true;
+                for (ssize_t k = 0; k < n; ++k) {
+                    if ((uint8_t)buf[k] < 4) arena.setDirection(c.snake, (Direction)buf[k]);
+                }
+            }
+            if (!drop && (ev & POLLOUT)) drop = !flushClient(c);
+            if (drop) {
+                arena.leave(c.snake);
+                close(c.fd);
+                clients[i] = std::move(clients.back());
+                clients.pop_back();
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while (true) {
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) break;
+                int one = 1;
+                if (addr.unix_path.empty()) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                Client c;
+                c.fd = fd;
+                c.snake = arena.join();
+                size_t start = beginMessage(c.out, 'W');
+                putVarint(c.out, (uint64_t)width);
+                putVarint(c.out, (uint64_t)height);
+                putVarint(c.out, (uint64_t)c.snake);
+                putVarint(c.out, (uint64_t)tick_ms);
+                endMessage(c.out, start);
+                encodeFull(arena, c.out);
+                if (flushClient(c)) {
+                    clients.push_back(std::move(c));
+                } else {
+                    arena.leave(c.snake);
+                    close(fd);
+                }
+            }
+        }
+
+        if ((fds[1].revents & POLLIN) && timer.consume() > 0) {
+            uint64_t t0 = monotonicNs();
+            for (int id : bot_ids) {
+                if (arena.getSnakes()[id].alive) arena.setDirection(id, steerBot(arena, id));
+            }
+            arena.step();
+            delta.clear();
+            encodeDelta(arena, delta);
+            // One encoding for everyone, appended to each backlog and pushed out right away
+            for (size_t i = clients.size(); i-- > 0;) {
+                Client& c = clients[i];
+                c.out += delta;
+                if (!flushClient(c)) {
+                    arena.leave(c.snake);
+                    close(c.fd);
+                    clients[i] = std::move(clients.back());
+                    clients.pop_back();
+                }
+            }
+            uint64_t cost = monotonicNs() - t0;
+            tick_cost.record(cost);
+            second_cost.record(cost);
+            if (cost > tick_ns) {
+                overruns++;
+                second_overruns++;
+            }
+            bytes += delta.size() * clients.size();
+            second_bytes += delta.size() * clients.size();
+            second_ticks++;
+            // Fell a whole tick behind: restart the cadence rather than burst to catch up
+            if (timer.lateNs() > tick_ns) timer.start(tick_ms);
+            else timer.schedule(tick_ms);
+        }
+
+        uint64_t now = monotonicNs();
+        if (now >= next_report) {
+            int alive = 0;
+            for (const auto& s : arena.getSnakes()) alive += s.alive;
+            char line[256];
+            snprintf(line, sizeof(line),
+                     "%3llus  clients %4zu  snakes alive %4d  tick p50 %7.1f us  p99 %7.1f us  max %7.1f us  "
+                     "overruns %llu  sent %llu B/tick",
+                     (unsigned long long)((now - started) / 1000000000ULL), clients.size(), alive,
+                     second_cost.percentile(0.5) / 1e3, second_cost.percentile(0.99) / 1e3, second_cost.max() / 1e3,
+                     (unsigned long long)second_overruns,
+                     (unsigned long long)(second_ticks ? second_bytes / second_ticks : 0));
+            std::cout << line << std::endl;
+            second_cost = Histogram();
+            second_overruns = 0;
+            second_bytes = 0;
+            second_ticks = 0;
+            next_report += 1000000000ULL;
+            if (seconds > 0 && now - started >= (uint64_t)seconds * 1000000000ULL) break;
+        }
+    }
+
+    for (const auto& c : clients) close(c.fd);
+    close(listener);
+    if (!addr.unix_path.empty()) unlink(addr.unix_path.c_str());
+    std::cout << "ticks:         " << tick_cost.count() << "\n"
+              << "tick p50:      " << tick_cost.percentile(0.5) / 1e3 << " us\n"
+              << "tick p99:      " << tick_cost.percentile(0.99) / 1e3 << " us\n"
+              << "tick max:      " << tick_cost.max() / 1e3 << " us\n"
+              << "overruns:      " << overruns << (overruns ? "" : " (kept up)") << "\n"
+              << "bytes sent:    " << bytes << "\n";
+    return 0;
+}
+
+static int runClients(const Address& addr, int count, int seconds) {
+    std::vector<pollfd> fds;
+    for (int i = 0; i < count; ++i) {
+        int fd = connectTo(addr);
+        if (fd < 0) {
+            perror("connect");
+            break;
+        }
+        fds.push_back({fd, POLLIN, 0});
+    }
+    std::cout << "connected " << fds.size() << " clients\n";
+
+    Rng rng((uint64_t)getpid());
+    TickTimer timer;
+    timer.start(20);
+    fds.push_back({timer.fd(), POLLIN, 0});
+    uint64_t received = 0, second_received = 0;
+    size_t dropped = 0;
+    uint64_t started = monotonicNs();
+    uint64_t next_report = started + 1000000000ULL;
+    static char buf[65536];
+    while (!stop_requested && fds.size() > 1) {
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;
+        size_t clients = fds.size() - 1;
+        for (size_t i = clients; i-- > 0;) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+            if (n > 0) {
+                received += (uint64_t)n;
+                second_received += (uint64_t)n;
+            } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close(fds[i].fd);
+                fds.erase(fds.begin() + i);
+                dropped++;
+            }
+        }
+        // Every 20 ms a quarter of the clients turn somewhere at random
+        if ((fds.back().revents & POLLIN) && timer.consume() > 0) {
+            for (size_t i = 0; i + 1 < fds.size(); ++i) {
+                if (rng.below(4)) continue;
+                char dir = (char)rng.below(4);
+                (void)!send(fds[i].fd, &dir, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+            timer.schedule(20);
+        }
+        uint64_t now = monotonicNs();
+        if (now >= next_report) {
+            std::cout << (now - started) / 1000000000ULL << "s  clients " << fds.size() - 1 << "  received "
+                      << second_received / 1024 << " KiB/s\n";
+            second_received = 0;
+            next_report += 1000000000ULL;
+            if (seconds > 0 && now - started >= (uint64_t)seconds * 1000000000ULL) break;
+        }
+    }
+    for (size_t i = 0; i + 1 < fds.size(); ++i) close(fds[i].fd);
+    std::cout << "received:      " << received << " bytes\n"
+              << "dropped:       " << dropped << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Address addr;
+    int width = 200;
+    int height = 100;
+    int bots = 0;
+    int food = -1;
+    int tick_ms = 0;
+    int seconds = 0;
+    int clients = 0;
+    bool connect_mode = false;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--unix") && has_value) {
+            addr.unix_path = argv[++i];
+        } else if (!strcmp(argv[i], "--tcp") && has_value) {
+            addr.tcp_port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--size") && has_value) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--bots") && has_value) {
+            bots = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--food") && has_value) {
+            food = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--tick-ms") && has_value) {
+            tick_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && has_value) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--seconds") && has_value) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--connect")) {
+            connect_mode = true;
+        } else if (!strcmp(argv[i], "--clients") && has_value) {
+            clients = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((addr.unix_path.empty() && addr.tcp_port <= 0) || width < 10 || height < 5 ||
+        (int64_t)width * height > Board::DENSE_MAX_CELLS || (connect_mode && clients <= 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (connect_mode) return runClients(addr, clients, seconds);
+    if (tick_ms <= 0) tick_ms = Game(width, height, (int)DIFFICULTIES.size() - 1, seed).computeTickMs();
+    if (food < 0) food = std::max(1, (width * height) / 400);
+    return runServer(addr, width, height, bots, food, tick_ms, seed, seconds);
+}
@@ -0,0 +1,232 @@
+#include "game.h"
+#include "rng.h"
+#include "batch_env.h"
+#include "autopilot.h"
+#include "replay.h"
+#include "render.h"
+#include "level.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--ticks N] [--seed S] [--size WxH] [--difficulty 0-3] [--script UDLR. | --auto]\n"
+              << "       " << prog << " --batch N [--threads T] [--ticks N] [--seed S] [--size WxH]\n"
+              << "  --script  one letter per tick (U/D/L/R to turn, '.' to keep going), repeated;\n"
+              << "            without it the snake turns at random\n"
+              << "  --auto    let the autopilot steer and report its per-tick cost\n"
+              << "       " << prog << " [--level FILE | --maze WxH] [--foods N] ...\n"
+              << "  --level   play a level file instead of an empty board, --maze a generated maze;\n"
+              << "            --foods overrides how many foods are out at once\n"
+              << "       " << prog << " --replay FILE [--replay FILE ...] [--render]\n"
+              << "  --replay  re-simulate recorded sessions at full speed, --render also draws every tick\n"
+              << "  --batch   step N boards at once through the batched environment, --ticks counts batch steps\n";
+}
+
+static int runBatch(int batch, int threads, uint64_t steps, uint64_t seed, int width, int height) {
+    SnakeBatch* env = snake_batch_create(batch, width, height, seed, threads);
+    if (!env) return 1;
+
+    // Random actions come from a pre-generated table so the benchmark measures the environment
+    Rng input_rng(seed ^ 0x9e3779b97f4a7c15ULL);
+    std::vector<int8_t> action_table(batch + 65536);
+    for (auto& a : action_table) a = input_rng.below(4) == 0 ? (int8_t)input_rng.below(4) : -1;
+    std::vector<float> rewards(batch);
+    std::vector<uint8_t> done(batch);
+    uint64_t episodes = 0;
+    uint64_t food = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t t = 0; t < steps; ++t) {
+        snake_batch_step(env, &action_table[(t * 7919) % 65536], rewards.data(), done.data());
+        for (int e = 0; e < batch; ++e) {
+            episodes += done[e];
+            food += rewards[e] > 0;
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    snake_batch_destroy(env);
+
+    uint64_t env_steps = steps * batch;
+    std::cout << "boards:        " << batch << "\n"
+              << "env steps:     " << env_steps << "\n"
+              << "episodes:      " << episodes << "\n"
+              << "food eaten:    " << food << "\n"
+              << "elapsed:       " << secs << " s\n"
+              << "steps/second:  " << (secs > 0 ? (uint64_t)(env_steps / secs) : 0) << "\n";
+    return 0;
+}
+
+static int runReplays(const std::vector<string>& paths, bool render) {
+    uint64_t ticks = 0;
+    size_t bytes = 0;
+    int failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& path : paths) {
+        Replay replay;
+        if (!loadReplay(path, replay)) {
+            std::cerr << path << ": not a valid replay\n";
+            failed++;
+            continue;
+        }
+        std::unique_ptr<Renderer> renderer;
+        if (render) renderer.reset(new Renderer(replay.width, replay.height));
+        Game game = renderer ? playReplay(replay, [&](const Game& g) { renderer->draw(g); }) : playReplay(replay);
+        if (renderer) bytes += renderer->getTotalBytes();
+        ticks += game.getTicks();
+        std::cout << path << ": " << replay.width << "x" << replay.height << " " << DIFFICULTIES[replay.difficulty].name
+                  << ", " << game.getTicks() << " ticks, score " << game.getScore()
+                  << (game.isGameOver() ? ", died" : "") << "\n";
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "replays:       " << paths.size() - failed << "\n"
+              << "ticks:         " << ticks << "\n"
+              << "elapsed:       " << secs << " s\n"
+              << "ticks/second:  " << (secs > 0 ? (uint64_t)(ticks / secs) : 0) << "\n";
+    if (render && ticks > 0) std::cout << "bytes/frame:   " << bytes / ticks << "\n";
+    return failed ? 1 : 0;
+}
+
+static bool isReverse(Direction a, Direction b) {
+    return (a == UP && b == DOWN) || (a == DOWN && b == UP) || (a == LEFT && b == RIGHT) || (a == RIGHT && b == LEFT);
+}
+
+int main(int argc, char** argv) {
+    uint64_t max_ticks = 1000000;
+    uint64_t seed = 1;
+    int width = 40;
+    int height = 20;
+    int diff = 1;
+    string script;
+    int batch = 0;
+    int threads = 0;
+    bool autopilot = false;
+    bool render = false;
+    std::vector<string> replays;
+    string level_path;
+    int maze_width = 0;
+    int maze_height = 0;
+    int foods = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--ticks") && has_value) {
+            max_ticks = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--seed") && has_value) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--size") && has_value) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--difficulty") && has_value) {
+            diff = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--script") && has_value) {
+            script = argv[++i];
+        } else if (!strcmp(argv[i], "--replay") && has_value) {
+            replays.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--level") && has_value) {
+            level_path = argv[++i];
+        } else if (!strcmp(argv[i], "--maze") && has_value) {
+            if (sscanf(argv[++i], "%dx%d", &maze_width, &maze_height) != 2 || maze_width < 5 || maze_height < 3) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--foods") && has_value) {
+            foods = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--render")) {
+            render = true;
+        } else if (!strcmp(argv[i], "--auto")) {
+            autopilot = true;
+        } else if (!strcmp(argv[i], "--batch") && has_value) {
+            batch = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && has_value) {
+            threads = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width < 4 || height < 2 || diff < 0 || diff >= (int)DIFFICULTIES.size()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!replays.empty()) return runReplays(replays, render);
+    if (batch > 0) return runBatch(batch, threads, max_ticks, seed, width, height);
+
+    Level level;
+    if (!level_path.empty()) {
+        string error;
+        if (!loadLevel(level_path, level, error)) {
+            std::cerr << level_path << ": " << error << "\n";
+            return 1;
+        }
+    } else if (maze_width) {
+        level = makeMaze(maze_width, maze_height, 1, seed);
+    }
+    if (foods > 0) level.food_count = foods;
+    Game game = level.width ? Game(level, diff, seed) : Game(width, height, diff, seed);
+    Rng input_rng(seed ^ 0x9e3779b97f4a7c15ULL);
+    uint64_t games = 1;
+    uint64_t total_score = 0;
+    int best = 0;
+    size_t script_pos = 0;
+    Autopilot pilot;
+    double pilot_secs = 0;
+    double pilot_worst = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t t = 0; t < max_ticks; ++t) {
+        Direction next = game.getDirection();
+        if (autopilot) {
+            auto t0 = std::chrono::steady_clock::now();
+            next = pilot.choose(game);
+            double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            pilot_secs += dt;
+            if (dt > pilot_worst) pilot_worst = dt;
+        } else if (!script.empty()) {
+            switch (script[script_pos]) {
+                case 'U': next = UP; break;
+                case 'D': next = DOWN; break;
+                case 'L': next = LEFT; break;
+                case 'R': next = RIGHT; break;
+                default: break;
+            }
+            script_pos = (script_pos + 1) % script.size();
+        } else if (input_rng.below(4) == 0) {
+            next = (Direction)input_rng.below(4);
+        }
+        if (!isReverse(game.getDirection(), next)) game.setDirection(next);
+
+        game.step();
+        if (game.isGameOver()) {
+            total_score += game.getScore();
+            if (game.getScore() > best) best = game.getScore();
+            games++;
+            game.reset();
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    total_score += game.getScore();
+    if (game.getScore() > best) best = game.getScore();
+    std::cout << "ticks:         " << max_ticks << "\n"
+              << "games:         " << games << "\n"
+              << "best score:    " << best << "\n"
+              << "avg score:     " << (double)total_score / games << "\n"
+              << "elapsed:       " << secs << " s\n"
+              << "ticks/second:  " << (secs > 0 ? (uint64_t)(max_ticks / secs) : 0) << "\n";
+    if (autopilot && max_ticks > 0) {
+        std::cout << "autopilot avg: " << pilot_secs / max_ticks * 1e6 << " us/tick\n"
+                  << "autopilot max: " << pilot_worst * 1e6 << " us\n";
+    }
+    return 0;
+}
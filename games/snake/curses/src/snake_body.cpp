@@ -0,0 +1,43 @@
+#include "snake_body.h"
+#include <algorithm>
+
+SnakeBody::SnakeBody(int width, int height) : capacity(0), head(0), len(0), width(0) {
+    reset(width, height);
+}
+
+void SnakeBody::reset(int new_width, int new_height) {
+    width = (uint32_t)new_width;
+    capacity = (size_t)new_width * new_height;
+    ring.assign(std::min(capacity, INITIAL_CAPACITY), 0);
+    head = 0;
+    len = 0;
+}
+
+// Unrolls the ring into a buffer twice the size, capped at the board area
+void SnakeBody::grow() {
+    std::vector<uint32_t> bigger(std::min(capacity, ring.size() * 2));
+    for (size_t i = 0; i < len; ++i) bigger[i] = cellAt(i);
+    ring.swap(bigger);
+    head = 0;
+}
+
+void SnakeBody::pushFront(Point p) {
+    if (len == ring.size()) grow();
+    head = head == 0 ? ring.size() - 1 : head - 1;
+    ring[head] = (uint32_t)p.y * width + (uint32_t)p.x;
+    head_point = p;
+    if (len++ == 0) tail_point = p;
+}
+
+void SnakeBody::popBack() {
+    uint32_t old_tail = cellAt(--len);
+    if (len == 0) return;
+    // The new tail is usually a neighbour of the old one, so step the cached point instead of
+    // unpacking. After a portal, cells on either side of a row break are index neighbours too.
+    uint32_t new_tail = cellAt(len - 1);
+    if (new_tail == old_tail + 1 && (uint32_t)tail_point.x + 1 < width) tail_point.x++;
+    else if (new_tail + 1 == old_tail && tail_point.x > 0) tail_point.x--;
+    else if (new_tail == old_tail + width) tail_point.y++;
+    else if (new_tail + width == old_tail) tail_point.y--;
+    else tail_point = (*this)[len - 1];
+}
@@ -0,0 +1,97 @@
+#include "stats.h"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+
+int Histogram::bucketOf(uint64_t v) {
+    if (v < 8) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    return 8 + (e - 3) * 8 + (int)((v >> (e - 3)) & 7);
+}
+
+uint64_t Histogram::bucketUpper(int i) {
+    if (i < 8) return (uint64_t)i;
+    int e = (i - 8) / 8 + 3;
+    uint64_t sub = (uint64_t)((i - 8) % 8);
+    return ((8 + sub) << (e - 3)) + (((uint64_t)1 << (e - 3)) - 1);
+}
+
+void Histogram::record(uint64_t v) {
+    counts[bucketOf(v)]++;
+    total++;
+    sum += v;
+    if (v > largest) largest = v;
+}
+
+uint64_t Histogram::count() const {
+    return total;
+}
+
+uint64_t Histogram::max() const {
+    return largest;
+}
+
+double Histogram::mean() const {
+    return total ? (double)sum / total : 0.0;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(p * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return bucketUpper(i) < largest ? bucketUpper(i) : largest;
+    }
+    return largest;
+}
+
+void Histogram::writeJson(std::ostream& out) const {
+    out << "{\"count\": " << total << ", \"mean\": " << mean() << ", \"p50\": " << percentile(0.5)
+        << ", \"p90\": " << percentile(0.9) << ", \"p99\": " << percentile(0.99) << ", \"max\": " << largest
+        << ", \"buckets\": [";
+    bool first = true;
+    for (int i = 0; i < BUCKETS; ++i) {
+        if (!counts[i]) continue;
+        out << (first ? "" : ", ") << "[" << bucketUpper(i) << ", " << counts[i] << "]";
+        first = false;
+    }
+    out << "]}";
+}
+
+std::string LoopStats::hudLine() const {
+    char line[160];
+    snprintf(line, sizeof(line), "tick %.1f/%.1fus  draw %.1f/%.1fus  %lluB  late %.2f/%.2fms  key %.0f/%.0fms",
+             tick_ns.percentile(0.5) / 1e3, tick_ns.percentile(0.99) / 1e3,
+             render_ns.percentile(0.5) / 1e3, render_ns.percentile(0.99) / 1e3,
+             (unsigned long long)frame_bytes.percentile(0.5),
+             jitter_ns.percentile(0.5) / 1e6, jitter_ns.percentile(0.99) / 1e6,
+             key_to_draw_ns.percentile(0.5) / 1e6, key_to_draw_ns.percentile(0.99) / 1e6);
+    return line;
+}
+
+bool LoopStats::save(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) return false;
+    const std::pair<const char*, const Histogram*> all[] = {
+        {"tick_ns", &tick_ns},
+        {"render_ns", &render_ns},
+        {"frame_bytes", &frame_bytes},
+        {"jitter_ns", &jitter_ns},
+        {"key_to_draw_ns", &key_to_draw_ns},
+    };
+    out << "{\n";
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); ++i) {
+        out << "  \"" << all[i].first << "\": ";
+        all[i].second->writeJson(out);
+        out << (i + 1 < sizeof(all) / sizeof(all[0]) ? ",\n" : "\n");
+    }
+    out << "}\n";
+    return (bool)out;
+}
+
+uint64_t monotonicNs() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
@@ -3,30 +3,34 @@
 #include <unistd.h>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <signal.h>
+#include <sys/signalfd.h>
 
-std::atomic<bool> Terminal::resized(false);
 static struct termios orig_term;
 static bool raw_enabled = false;
 
-static void handle_exit_signal(int) {
-    if (raw_enabled) {
-        tcsetattr(STDIN_FILENO, TCSANOW, &orig_term);
-        raw_enabled = false;
+void Terminal::setupSignals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) == -1) {
+        perror("sigprocmask");
+        exit(1);
+    }
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        perror("signalfd");
+        exit(1);
     }
-    write(STDOUT_FILENO, "\033[?25h", 6);
-    _exit(0);
-}
-
-void Terminal::setupSignalHandlers() {
-    signal(SIGINT, handle_exit_signal);
-    signal(SIGTERM, handle_exit_signal);
-    signal(SIGWINCH, [](int){ Terminal::setResized(true); });
 }
 
-Terminal::Terminal() {
-    setupSignalHandlers();
+Terminal::Terminal() : signal_fd(-1) {
+    setupSignals();
     enableRawMode();
     atexit([](){
         if (raw_enabled) {
@@ -39,6 +43,7 @@ Terminal::Terminal() {
 
 Terminal::~Terminal() {
     disableRawMode();
+    if (signal_fd != -1) close(signal_fd);
 }
 
 void Terminal::enableRawMode() {
@@ -79,10 +84,32 @@ void Terminal::getWindowSize(int& width, int& height) {
     }
 }
 
-bool Terminal::isResized() {
-    return resized.load();
+bool Terminal::supportsSyncUpdates() {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) return false;
+    static const char query[] = "\033[?2026$p";
+    write(STDOUT_FILENO, query, sizeof(query) - 1);
+
+    // Reply is ESC [ ? 2026 ; Ps $ y, where Ps 1 or 2 means the mode is known
+    char reply[32];
+    int len = 0;
+    pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    while (len < (int)sizeof(reply) - 1 && poll(&pfd, 1, 100) > 0) {
+        ssize_t r = read(STDIN_FILENO, reply + len, sizeof(reply) - 1 - len);
+        if (r <= 0) break;
+        len += r;
+        if (reply[len - 1] == 'y') break;
+    }
+    reply[len] = '\0';
+    const char* p = strstr(reply, "?2026;");
+    return p && (p[6] == '1' || p[6] == '2');
+}
+
+int Terminal::signalFd() const {
+    return signal_fd;
 }
 
-void Terminal::setResized(bool value) {
-    resized.store(value);
+int Terminal::readSignal() {
+    signalfd_siginfo info;
+    if (read(signal_fd, &info, sizeof(info)) != sizeof(info)) return 0;
+    return (int)info.ssi_signo;
 }
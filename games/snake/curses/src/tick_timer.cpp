@@ -0,0 +1,66 @@
+#include "tick_timer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static void addMs(timespec& t, int ms) {
+    t.tv_sec += ms / 1000;
+    t.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (t.tv_nsec >= 1000000000L) {
+        t.tv_sec++;
+        t.tv_nsec -= 1000000000L;
+    }
+}
+
+TickTimer::TickTimer() : deadline{0, 0} {
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        perror("timerfd_create");
+        exit(1);
+    }
+}
+
+TickTimer::~TickTimer() {
+    close(timer_fd);
+}
+
+void TickTimer::arm() {
+    itimerspec spec = {};
+    spec.it_value = deadline;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void TickTimer::start(int ms) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    addMs(deadline, ms);
+    arm();
+}
+
+void TickTimer::schedule(int ms) {
+    addMs(deadline, ms);
+    arm();
+}
+
+void TickTimer::stop() {
+    itimerspec spec = {};
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+    consume();
+}
+
+uint64_t TickTimer::consume() {
+    uint64_t expirations = 0;
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return 0;
+    return expirations;
+}
+
+uint64_t TickTimer::lateNs() const {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t late = (int64_t)(now.tv_sec - deadline.tv_sec) * 1000000000LL + (now.tv_nsec - deadline.tv_nsec);
+    return late > 0 ? (uint64_t)late : 0;
+}
+
+int TickTimer::fd() const {
+    return timer_fd;
+}
@@ -1,6 +1,16 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include "game.h"
 #include "input.h"
+#include "board.h"
+#include "frame_buffer.h"
+#include "batch_env.h"
+#include "autopilot.h"
+#include "replay.h"
+#include "stats.h"
+#include "snake_body.h"
+#include "arena.h"
+#include "level.h"
 
 TEST(GameTest, Initialization) {
     Game game(20, 10, 0);
@@ -11,7 +21,7 @@ TEST(GameTest, Initialization) {
 TEST(GameTest, SnakeMovement) {
     Game game(20, 10, 0, {{10, 5}, {9, 5}, {8, 5}}, {15, 15});
     
-    game.update(); // Moves RIGHT by default
+    game.step(); // Moves RIGHT by default
     auto snake = game.getSnake();
     EXPECT_EQ(snake.front().x, 11);
     EXPECT_EQ(snake.front().y, 5);
@@ -20,7 +30,7 @@ TEST(GameTest, SnakeMovement) {
 
 TEST(GameTest, WallCollision) {
     Game game(20, 10, 0, {{19, 5}, {18, 5}, {17, 5}}, {15, 15});
-    game.update(); // Moves RIGHT into the wall
+    game.step(); // Moves RIGHT into the wall
     EXPECT_TRUE(game.isGameOver());
 }
 
@@ -31,11 +41,11 @@ TEST(GameTest, SelfCollision) {
     //         B
     Game game(20, 10, 0, {{10, 5}, {10, 6}, {10, 7}, {10, 8}, {11, 8}}, {15, 15});
     game.setDirection(UP);
-    game.update(); // Up
+    game.step(); // Up
     game.setDirection(LEFT);
-    game.update(); // Left
+    game.step(); // Left
     game.setDirection(DOWN);
-    game.update(); // Down, collides with {10, 6}
+    game.step(); // Down, collides with {10, 6}
     EXPECT_TRUE(game.isGameOver());
 }
 
@@ -44,10 +54,467 @@ TEST(GameTest, FoodConsumption) {
     EXPECT_EQ(game.getScore(), 0);
     EXPECT_EQ(game.getSnake().size(), 3);
 
-    game.update(); // Moves RIGHT and eats the food
+    game.step(); // Moves RIGHT and eats the food
 
     EXPECT_EQ(game.getScore(), 1);
     EXPECT_EQ(game.getSnake().size(), 4);
     EXPECT_NE(game.getFood().x, 11); // Food should have moved
     EXPECT_NE(game.getFood().y, 5);
 }
+
+TEST(BoardTest, FreeCellIndex) {
+    Board board(4, 3);
+    EXPECT_EQ(board.freeCount(), 12);
+    board.occupy(1, 1);
+    board.occupy(3, 2);
+    board.occupy(1, 1); // Occupying twice is a no-op
+    EXPECT_EQ(board.freeCount(), 10);
+    EXPECT_FALSE(board.isFree(1, 1));
+    for (int i = 0; i < board.freeCount(); ++i) {
+        int idx = board.freeCellAt(i);
+        EXPECT_NE(idx, 1 * 4 + 1);
+        EXPECT_NE(idx, 2 * 4 + 3);
+    }
+    board.vacate(1, 1);
+    EXPECT_TRUE(board.isFree(1, 1));
+    EXPECT_EQ(board.freeCount(), 11);
+}
+
+TEST(GameTest, MoveIntoVacatedTail) {
+    // A 2x2 loop: the head moves into the cell the tail leaves on the same tick
+    Game game(20, 10, 0, {{10, 5}, {10, 6}, {11, 6}, {11, 5}}, {15, 15});
+    game.setDirection(RIGHT);
+    game.step();
+    EXPECT_FALSE(game.isGameOver());
+    EXPECT_EQ(game.getSnake().front().x, 11);
+    EXPECT_EQ(game.getSnake().front().y, 5);
+}
+
+TEST(GameTest, TickChangeList) {
+    Game game(20, 10, 0, {{10, 5}, {9, 5}, {8, 5}}, {11, 5});
+    game.step(); // Eats the food, so the tail stays
+    const auto& changes = game.getChanges();
+    ASSERT_EQ(changes.size(), 3);
+    EXPECT_EQ(changes[0].kind, CellKind::BODY);
+    EXPECT_EQ(changes[0].p, Point(10, 5));
+    EXPECT_EQ(changes[1].kind, CellKind::HEAD);
+    EXPECT_EQ(changes[1].p, Point(11, 5));
+    EXPECT_EQ(changes[2].kind, CellKind::FOOD);
+
+    game.step();
+    ASSERT_EQ(game.getChanges().size(), 3);
+    EXPECT_EQ(game.getChanges()[0].kind, CellKind::EMPTY);
+    EXPECT_EQ(game.getChanges()[0].p, Point(8, 5));
+}
+
+TEST(FrameBufferTest, FormatsCursorMoves) {
+    FrameBuffer frame(4); // Starts small to exercise growth
+    frame.moveCursor(12, 305);
+    frame.appendInt(-7);
+    frame.appendInt(0);
+    EXPECT_EQ(std::string(frame.data(), frame.size()), "\033[12;305H-70");
+    frame.clear();
+    EXPECT_EQ(frame.size(), 0u);
+}
+
+TEST(GameTest, SeededGamesAreDeterministic) {
+    Game a(40, 20, 1, 1234);
+    Game b(40, 20, 1, 1234);
+    EXPECT_EQ(a.getFood(), b.getFood());
+    for (int i = 0; i < 200 && !a.isGameOver(); ++i) {
+        Direction d = (i / 7) % 2 ? DOWN : RIGHT;
+        if (i % 13 == 0) d = UP;
+        a.setDirection(d);
+        b.setDirection(d);
+        a.step();
+        b.step();
+        ASSERT_EQ(a.getFood(), b.getFood());
+        ASSERT_EQ(a.getSnake().front(), b.getSnake().front());
+        ASSERT_EQ(a.isGameOver(), b.isGameOver());
+    }
+    EXPECT_EQ(a.getTicks(), b.getTicks());
+}
+
+TEST(BatchEnvTest, MatchesGameRules) {
+    const uint64_t seed = 77;
+    SnakeBatch* env = snake_batch_create(1, 30, 15, seed, 1);
+    ASSERT_NE(env, nullptr);
+    Game game(30, 15, 1, seed);
+    float reward = 0;
+    uint8_t done = 0;
+    for (int i = 0; i < 2000; ++i) {
+        // Head greedily for the food so the game lasts long enough to grow
+        Point head = game.getSnake().front();
+        const Point& food = game.getFood();
+        Direction d = food.x > head.x ? RIGHT : food.x < head.x ? LEFT : food.y > head.y ? DOWN : UP;
+        if ((d ^ 1) == game.getDirection()) d = (d == LEFT || d == RIGHT) ? UP : LEFT;
+        int8_t a = (int8_t)d;
+        game.setDirection(d);
+        game.step();
+        snake_batch_step(env, &a, &reward, &done);
+        ASSERT_EQ(done != 0, game.isGameOver());
+        if (done) break; // The batch reuses its free-cell order on reset, so food draws diverge
+        ASSERT_EQ(snake_batch_heads(env)[0], game.getSnake().front().y * 30 + game.getSnake().front().x);
+        ASSERT_EQ(snake_batch_food(env)[0], game.getFood().y * 30 + game.getFood().x);
+        ASSERT_EQ(snake_batch_scores(env)[0], game.getScore());
+    }
+    EXPECT_GT(game.getScore(), 5);
+    snake_batch_destroy(env);
+}
+
+TEST(AutopilotTest, SurvivesAndEats) {
+    Game game(20, 10, 1, 99);
+    Autopilot pilot;
+    for (int i = 0; i < 5000 && !game.isGameOver(); ++i) {
+        game.setDirection(pilot.choose(game));
+        game.step();
+    }
+    EXPECT_FALSE(game.isGameOver());
+    EXPECT_GT(game.getScore(), 40);
+}
+
+TEST(ReplayTest, RecordingReproducesGame) {
+    Game game(30, 15, 2, 4242);
+    Autopilot pilot;
+    ReplayRecorder recorder;
+    recorder.start(game);
+    for (int i = 0; i < 3000 && !game.isGameOver(); ++i) {
+        game.setDirection(pilot.choose(game));
+        recorder.beforeStep(game);
+        game.step();
+    }
+    const Replay& recorded = recorder.finish(game);
+    EXPECT_FALSE(recorded.turns.empty());
+
+    std::string data = encodeReplay(recorded);
+    EXPECT_LT(data.size(), recorded.turns.size() * 3 + 32);
+    Replay decoded;
+    ASSERT_TRUE(decodeReplay(data, decoded));
+    EXPECT_EQ(decoded.seed, 4242u);
+    EXPECT_EQ(decoded.difficulty, 2);
+    EXPECT_EQ(decoded.turns.size(), recorded.turns.size());
+
+    Game replayed = playReplay(decoded);
+    EXPECT_EQ(replayed.getTicks(), game.getTicks());
+    EXPECT_EQ(replayed.getScore(), game.getScore());
+    EXPECT_EQ(replayed.getSnake().front(), game.getSnake().front());
+    EXPECT_EQ(replayed.getFood(), game.getFood());
+
+    EXPECT_FALSE(decodeReplay(data.substr(0, data.size() - 1), decoded));
+}
+
+TEST(ReplayTest, BoardSizeLimits) {
+    // A world as large as --world accepts still loads back
+    Replay big;
+    big.width = 60000;
+    big.height = 20000;
+    Replay decoded;
+    ASSERT_TRUE(decodeReplay(encodeReplay(big), decoded));
+    EXPECT_EQ(decoded.width, 60000);
+    EXPECT_EQ(decoded.height, 20000);
+
+    // 2^32 x 2^32 wraps to 0 cells when multiplied unchecked
+    std::string data = "SNKR\x02";
+    data += '\0';                                       // seed
+    data += '\0';                                       // difficulty
+    data += std::string("\x80\x80\x80\x80\x10", 5); // width
+    data += std::string("\x80\x80\x80\x80\x10", 5); // height
+    data += std::string("\0\0\0", 3);                 // end tick, turns, no level
+    EXPECT_FALSE(decodeReplay(data, decoded));
+}
+
+TEST(StatsTest, HistogramPercentiles) {
+    Histogram h;
+    EXPECT_EQ(h.percentile(0.5), 0u);
+    for (uint64_t v = 1; v <= 1000; ++v) h.record(v * 1000);
+    EXPECT_EQ(h.count(), 1000u);
+    EXPECT_EQ(h.max(), 1000000u);
+    EXPECT_DOUBLE_EQ(h.mean(), 500500.0);
+    // Buckets are at most 12.5% wide
+    EXPECT_GE(h.percentile(0.5), 500000u);
+    EXPECT_LE(h.percentile(0.5), 500000u * 9 / 8);
+    EXPECT_GE(h.percentile(0.99), 990000u);
+    EXPECT_EQ(h.percentile(1.0), 1000000u);
+
+    Histogram small;
+    for (uint64_t v = 0; v < 8; ++v) small.record(v);
+    EXPECT_EQ(small.percentile(0.0), 0u);
+    EXPECT_EQ(small.percentile(1.0), 7u);
+}
+
+TEST(SnakeBodyTest, WrapsAroundTheRing) {
+    // 3x2 board, the ring holds six cells
+    SnakeBody body(3, 2);
+    body.pushFront({0, 0});
+    body.pushFront({1, 0});
+    for (int i = 0; i < 20; ++i) {
+        Point next = i % 2 ? Point(1, 0) : Point(2, 1);
+        body.pushFront(next);
+        body.popBack();
+        ASSERT_EQ(body.size(), 2u);
+        ASSERT_EQ(body.front(), next);
+        ASSERT_EQ(body.cellAt(0), (uint32_t)(next.y * 3 + next.x));
+    }
+    body.pushFront({0, 1});
+    std::vector<Point> cells(body.begin(), body.end());
+    ASSERT_EQ(cells.size(), 3u);
+    EXPECT_EQ(cells[0], Point(0, 1));
+    EXPECT_EQ(cells[1], Point(1, 0));
+    EXPECT_EQ(cells[2], Point(2, 1));
+    EXPECT_EQ(body.back(), Point(2, 1));
+}
+
+TEST(BoardTest, ChunkedHugeWorld) {
+    Board board(10000, 10000);
+    ASSERT_TRUE(board.isChunked());
+    EXPECT_EQ(board.freeCount(), 100000000);
+    board.occupy(0, 0);
+    board.occupy(9999, 9999);
+    board.occupy(9999, 9999);
+    EXPECT_EQ(board.freeCount(), 99999998);
+    EXPECT_FALSE(board.isFree(9999, 9999));
+    EXPECT_TRUE(board.isFree(9998, 9999));
+    board.vacate(9999, 9999);
+    EXPECT_TRUE(board.isFree(9999, 9999));
+    EXPECT_EQ(board.freeCount(), 99999999);
+
+    Rng rng(7);
+    for (int i = 0; i < 100; ++i) EXPECT_NE(board.randomFreeCell(rng), 0);
+}
+
+TEST(GameTest, HugeWorldPlays) {
+    Game game(10000, 10000, 1, 3);
+    ASSERT_TRUE(game.getBoard().isChunked());
+    // Walk a square spiral long enough to cross several tiles
+    Direction dirs[4] = {RIGHT, DOWN, LEFT, UP};
+    int leg = 1;
+    for (int turn = 0; turn < 200 && !game.isGameOver(); ++turn) {
+        game.setDirection(dirs[turn % 4]);
+        for (int i = 0; i < leg; ++i) game.step();
+        if (turn % 2) leg++;
+    }
+    EXPECT_FALSE(game.isGameOver());
+    EXPECT_GT(game.getTicks(), 10000u);
+    EXPECT_GE(game.getFood().x, 0);
+}
+
+TEST(ArenaTest, SnakesSpawnDieAndLeave) {
+    Arena arena(40, 20, 0, 5);
+    int a = arena.join();
+    int b = arena.join();
+    arena.step();
+    const auto& snakes = arena.getSnakes();
+    ASSERT_TRUE(snakes[a].alive);
+    ASSERT_TRUE(snakes[b].alive);
+    EXPECT_EQ(arena.getBoard().freeCount(), 40 * 20 - 6);
+
+    // Driving up into the wall kills both within a board height
+    bool died[2] = {false, false};
+    for (int i = 0; i < 20; ++i) {
+        arena.setDirection(a, UP);
+        arena.setDirection(b, UP);
+        arena.step();
+        for (int id : arena.getDeaths()) died[id] = true;
+    }
+    EXPECT_TRUE(died[a]);
+    EXPECT_TRUE(died[b]);
+
+    arena.leave(b);
+    arena.step();
+    EXPECT_TRUE(snakes[a].alive);
+    EXPECT_FALSE(snakes[b].active);
+    EXPECT_EQ(arena.getBoard().freeCount(), 40 * 20 - 3);
+}
+
+TEST(ArenaTest, LeavingBetweenTicksIsBroadcast) {
+    Arena arena(40, 20, 0, 5);
+    int a = arena.join();
+    arena.step();
+    arena.step();
+    std::vector<uint32_t> cells;
+    for (size_t i = 0; i < arena.getSnakes()[a].body.size(); ++i) cells.push_back(arena.getSnakes()[a].body.cellAt(i));
+    ASSERT_EQ(cells.size(), 3u);
+
+    // Servers call leave() between ticks, the next tick's changes must still empty the cells
+    arena.leave(a);
+    arena.step();
+    for (uint32_t cell : cells) {
+        bool emptied = false;
+        for (const auto& c : arena.getChanges()) emptied |= c.cell == cell && c.kind == CellKind::EMPTY;
+        EXPECT_TRUE(emptied) << "cell " << cell;
+    }
+    // Reported once, not again on the tick after
+    arena.step();
+    EXPECT_TRUE(arena.getChanges().empty());
+}
+
+TEST(ArenaTest, OccupancyMatchesBodies) {
+    // A crowded board, so heads meet bodies and each other all the time
+    Arena arena(12, 6, 2, 11);
+    for (int i = 0; i < 6; ++i) arena.join();
+    Rng rng(3);
+    size_t deaths = 0;
+    for (int t = 0; t < 2000; ++t) {
+        for (int id = 0; id < 6; ++id) arena.setDirection(id, (Direction)rng.below(4));
+        arena.step();
+        deaths += arena.getDeaths().size();
+        size_t on_board = 0;
+        for (const auto& s : arena.getSnakes()) {
+            if (!s.alive) continue;
+            on_board += s.body.size();
+            for (const auto& p : s.body) ASSERT_FALSE(arena.getBoard().isFree(p.x, p.y));
+        }
+        ASSERT_EQ(arena.getBoard().freeCount(), 12 * 6 - (int)on_board);
+    }
+    EXPECT_GT(deaths, 100u);
+}
+
+TEST(LevelTest, ParsesAndRejects) {
+    Level level;
+    std::string error;
+    ASSERT_TRUE(parseLevel("; test\nfood 3\n########\n#..S..a#\n#a.#...\n########\n", level, error)) << error;
+    EXPECT_EQ(level.width, 8);
+    EXPECT_EQ(level.height, 4);
+    EXPECT_EQ(level.food_count, 3);
+    EXPECT_EQ(level.start, Point(3, 1));
+    ASSERT_EQ(level.portals.size(), 1u);
+    EXPECT_EQ(level.portals[0], std::make_pair(1 * 8 + 6, 2 * 8 + 1));
+    EXPECT_EQ(level.obstacles.size(), 8u + 2 + 2 + 8);
+
+    EXPECT_FALSE(parseLevel("......\n..S...\n..a...\n", level, error));  // unpaired portal
+    EXPECT_FALSE(parseLevel("......\n.S....\n", level, error));         // no room for the body
+    EXPECT_FALSE(parseLevel("..S.S.\n......\n", level, error));
+    EXPECT_FALSE(parseLevel("......\n......\n", level, error));
+    EXPECT_FALSE(parseLevel("food 0\n..S...\n......\n", level, error));
+}
+
+TEST(LevelTest, ObstaclesPortalsAndFoods) {
+    Level level;
+    std::string error;
+    ASSERT_TRUE(parseLevel("food 5\n...S.a....\n..........\n.......a..\n....#.....\n", level, error)) << error;
+    Game game(level, 1, 99);
+    EXPECT_TRUE(game.isObstacle(4, 3));
+    EXPECT_TRUE(game.isPortal(5, 0));
+    EXPECT_FALSE(game.getBoard().isFree(4, 3));
+    EXPECT_EQ(game.getFoods().size(), 5u);
+    for (const auto& f : game.getFoods()) {
+        EXPECT_TRUE(game.getBoard().isFree(f.x, f.y));
+        EXPECT_EQ(std::count(game.getFoods().begin(), game.getFoods().end(), f), 1);
+    }
+
+    // Head at (3,0) facing right: one step to (4,0), the next enters portal (5,0) and comes
+    // out of (7,2) one further right
+    game.step();
+    game.step();
+    ASSERT_FALSE(game.isGameOver());
+    EXPECT_EQ(game.getSnake().front(), Point(8, 2));
+
+    game.setDirection(DOWN);
+    game.step();
+    game.setDirection(LEFT);
+    for (int i = 0; i < 3; ++i) game.step();
+    EXPECT_EQ(game.getSnake().front(), Point(5, 3));
+    game.step();
+    EXPECT_TRUE(game.isGameOver()); // the obstacle at (4,3)
+}
+
+TEST(LevelTest, TailFollowsThroughPortal) {
+    Level level;
+    std::string error;
+    ASSERT_TRUE(parseLevel("..S...\na.....\n.....a\n......\n", level, error)) << error;
+    Game game(level, 0, 3);
+    // Down the last column into the portal at (5,2), out below (0,1) and along the bottom: the
+    // tail then goes from (5,1) to (0,2), neighbouring indices that are not neighbouring cells
+    const Direction moves[] = {RIGHT, RIGHT, RIGHT, DOWN, DOWN, DOWN, RIGHT, RIGHT};
+    for (Direction dir : moves) {
+        game.setDirection(dir);
+        game.step();
+        ASSERT_FALSE(game.isGameOver());
+        const SnakeBody& snake = game.getSnake();
+        Point tail = snake.back();
+        EXPECT_EQ(tail, snake[snake.size() - 1]);
+        EXPECT_TRUE(tail.x >= 0 && tail.x < level.width && tail.y >= 0 && tail.y < level.height);
+    }
+}
+
+TEST(LevelTest, MazeRunsAndReplays) {
+    Level maze = makeMaze(41, 21, 4, 7);
+    EXPECT_EQ(maze.start, Point(3, 1));
+    Game game(maze, 1, 7);
+    EXPECT_EQ(game.getFoods().size(), 4u);
+    Autopilot pilot;
+    ReplayRecorder recorder;
+    recorder.start(game);
+    for (int t = 0; t < 3000 && !game.isGameOver(); ++t) {
+        game.setDirection(pilot.choose(game));
+        Point head = game.getSnake().front();
+        recorder.beforeStep(game);
+        game.step();
+        if (!game.isGameOver()) {
+            Point next = game.getSnake().front();
+            ASSERT_FALSE(game.isObstacle(next.x, next.y)) << "from " << head.x << "," << head.y;
+        }
+    }
+    EXPECT_GT(game.getScore(), 0);
+
+    Replay decoded;
+    ASSERT_TRUE(decodeReplay(encodeReplay(recorder.finish(game)), decoded));
+    ASSERT_TRUE(decoded.has_level);
+    EXPECT_EQ(decoded.level.obstacles, maze.obstacles);
+    Game replayed = playReplay(decoded);
+    EXPECT_EQ(replayed.getTicks(), game.getTicks());
+    EXPECT_EQ(replayed.getScore(), game.getScore());
+    EXPECT_EQ(replayed.getFoods(), game.getFoods());
+}
+
+TEST(InputTest, DecodesSplitSequences) {
+    Input input;
+    // Up arrow split across three reads, then an SS3 left arrow, a modified right arrow and a key
+    input.feed("\033", 1);
+    EXPECT_TRUE(input.empty());
+    input.feed("[", 1);
+    input.feed("A\033O", 3);
+    input.feed("D\033[1;5Cq", 8);
+    EXPECT_EQ(input.pop(), UserAction::UP);
+    EXPECT_EQ(input.pop(), UserAction::LEFT);
+    EXPECT_EQ(input.pop(), UserAction::RIGHT);
+    EXPECT_EQ(input.pop(), UserAction::QUIT);
+    EXPECT_EQ(input.pop(), UserAction::NONE);
+
+    // Unknown sequences are swallowed whole, a lone ESC doesn't eat the next key
+    input.feed("\033[5~p\033w", 7);
+    EXPECT_EQ(input.pop(), UserAction::PAUSE);
+    EXPECT_EQ(input.pop(), UserAction::UP);
+    EXPECT_TRUE(input.empty());
+
+    for (int i = 0; i < Input::QUEUE_SIZE + 4; ++i) input.feed("s", 1);
+    int queued = 0;
+    while (input.pop() != UserAction::NONE) queued++;
+    EXPECT_EQ(queued, Input::QUEUE_SIZE);
+}
+
+TEST(GameTest, QueuedTurnsOnePerTick) {
+    Game game(20, 10, 0, {{10, 5}, {9, 5}, {8, 5}}, {15, 15});
+    Input input;
+    // UP then LEFT typed within one tick: a U-turn over two ticks, not just the last key
+    input.feed("\033[A\033[D", 6);
+    game.processInput(&input);
+    EXPECT_EQ(game.nextDirection(), UP);
+    game.step();
+    EXPECT_EQ(game.getSnake().front(), Point(10, 4));
+    EXPECT_EQ(game.nextDirection(), LEFT);
+    game.step();
+    EXPECT_EQ(game.getSnake().front(), Point(9, 4));
+
+    // Turns that reverse or repeat the direction are skipped without costing a tick
+    input.feed("ad\033[Cs", 6);  // 'd' is change difficulty, ignored while playing
+    game.processInput(&input);
+    game.step();
+    EXPECT_EQ(game.getSnake().front(), Point(9, 5));
+    EXPECT_EQ(game.getDirection(), DOWN);
+
+    input.feed("aw", 2);
+    game.processInput(&input);
+    game.setDirection(RIGHT);
+    EXPECT_EQ(game.nextDirection(), RIGHT);
+}
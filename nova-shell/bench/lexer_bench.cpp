@@ -0,0 +1,80 @@
+// Lexer throughput on a large generated script: nova lexer_bench [megabytes]
+#include "core/lexer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+
+
+// Every heap allocation in the program goes through here so lexing can be audited
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+
+// Lines in the shape of real scripts: commands with flags, paths, variables,
+// quoted strings, pipes, redirects and separators
+static std::string makeScript(size_t bytes) {
+  static const char *LINES[] = {
+    "ls -l -Ra ~/projects/nova-shell/src | grep \"lexer\" > /tmp/out.txt\n",
+    "echo \"Hello $USER, today is $(date)\" >> ~/.cache/nova/log.txt\n",
+    "if [ $COUNT >= 10 ] && [ $COUNT <= 20 ]; then echo 'in range'; fi\n",
+    "cat < input.txt | sort | uniq -c | sort -rn | head -n 20 || true\n",
+    "DAGE = AGE * 2 - 2\n",
+    "printf \"%s said \\\"hi\\\" to %s\\n\" $USER '$NAME'\n",
+    "make -j8 BUILD_DIR=/tmp/build && ./build/nova script-tests/test-01.nov\n",
+  };
+  std::string script;
+  script.reserve(bytes + 128);
+  for (size_t i = 0; script.size() < bytes; i++)
+    script += LINES[i % (sizeof(LINES) / sizeof(LINES[0]))];
+  return script;
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+  std::string script = makeScript(megabytes << 20);
+
+  // Best of a few runs, the first one also warms the allocator
+  double best = 1e30;
+  size_t count = 0;
+  size_t allocs = 0;
+  for (int run = 0; run < 5; run++) {
+    Lexer lex = Lexer::fromString(script);
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    vec_tok tokens = lex.tokenize_all();
+    allocs = allocations - before;
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (secs < best) best = secs;
+    count = tokens.size();
+  }
+
+  // The same script from a file: opening it and lexing the first line should cost
+  // about the same whatever its size, since only the touched pages are read
+  std::string path = "/tmp/nova_lexer_bench.nov";
+  std::ofstream(path, std::ios::binary) << script;
+  auto open_start = std::chrono::steady_clock::now();
+  Lexer file_lex = Lexer::fromFile(path);
+  size_t first = file_lex.tokenize_line().size();
+  double first_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - open_start).count();
+  size_t file_count = first + file_lex.tokenize_all().size();
+  double file_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - open_start).count();
+  std::remove(path.c_str());
+
+  std::cout << "lexer: " << script.size() / (1 << 20) << " MiB, " << count << " tokens, "
+            << best * 1e3 << " ms, " << (size_t)(count / best) << " tokens/s, "
+            << script.size() / best / (1 << 20) << " MiB/s, " << allocs << " allocations\n"
+            << "lexer from file: first line after " << first_secs * 1e6 << " us, " << file_count
+            << " tokens in " << file_secs * 1e3 << " ms\n";
+  return 0;
+}
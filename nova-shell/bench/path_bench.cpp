@@ -0,0 +1,37 @@
+// PATH resolution cost, hashed against searching PATH every time: nova path_bench [lookups]
+#include "utils/env.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+extern char **environ;
+
+
+int main(int argc, char *argv[]) {
+  size_t lookups = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+  Env env(environ);
+  // Commands a script typically runs, found at different depths of PATH
+  static const char *COMMANDS[] = { "ls", "cat", "grep", "sort", "sed", "env" };
+  const size_t count = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+  auto run = [&](bool hashed) {
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+      // Clearing the table every time is what resolution cost before it existed
+      if (!hashed) env.getCommandHash().clear();
+      found += !env.getFromPath(COMMANDS[i % count]).empty();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return std::make_pair(secs, found);
+  };
+
+  auto [cold, cold_found] = run(false);
+  auto [hashed, hashed_found] = run(true);
+
+  std::cout << "path: " << lookups << " lookups, " << cold_found << " found, PATH search "
+            << cold / lookups * 1e9 << " ns each, hashed " << hashed / lookups * 1e9 << " ns each ("
+            << hashed_found << " found)\n";
+  return 0;
+}
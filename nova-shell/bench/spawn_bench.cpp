@@ -0,0 +1,72 @@
+// Command launch latency against the shell's heap size, fork + execve versus
+// posix_spawn: nova spawn_bench [max heap megabytes]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+
+static const char *TRUE_PATH = "/bin/true";
+static const int RUNS = 50;
+
+static pid_t launch_fork(char *const *argv) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    execve(TRUE_PATH, argv, environ);
+    _exit(127);
+  }
+  return pid;
+}
+
+static pid_t launch_spawn(char *const *argv) {
+  pid_t pid;
+  if (posix_spawn(&pid, TRUE_PATH, nullptr, nullptr, argv, environ) != 0) return -1;
+  return pid;
+}
+
+// Median launch-to-exit time in microseconds
+static double measure(pid_t (*launch)(char *const *)) {
+  char *argv[] = { const_cast<char*>(TRUE_PATH), nullptr };
+  std::vector<double> times;
+  for (int i = 0; i < RUNS; i++) {
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = launch(argv);
+    if (pid < 0 || waitpid(pid, nullptr, 0) < 0) {
+      std::cerr << "spawn_bench: couldn't run " << TRUE_PATH << '\n';
+      std::exit(1);
+    }
+    times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6);
+  }
+  std::nth_element(times.begin(), times.begin() + RUNS / 2, times.end());
+  return times[RUNS / 2];
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+
+  // The heap stands in for history, environment and caches a long session builds up.
+  // Every page is touched so fork has real page tables to copy.
+  std::vector<char*> heap;
+  size_t heap_mb = 0;
+  for (size_t target = 0; target <= max_mb; target = target ? target * 4 : 8) {
+    for (; heap_mb < target; heap_mb++) {
+      char *block = static_cast<char*>(std::malloc(1 << 20));
+      std::memset(block, 1, 1 << 20);
+      heap.push_back(block);
+    }
+    double forked = measure(launch_fork);
+    double spawned = measure(launch_spawn);
+    std::cout << "spawn: heap " << heap_mb << " MiB, fork+exec " << forked << " us, posix_spawn "
+              << spawned << " us\n";
+  }
+
+  for (char *block : heap) std::free(block);
+  return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "core/lexer.h"
+
+
+// A script after lexing and the syntactic half of parsing: commands, arguments,
+// redirects and pipes as written. Nothing here depends on the environment, so it
+// can be cached; $VARS, $(...), ~ and PATH lookups happen when a line runs.
+
+// quote is the quote character the word was written in, 0 for a bare word
+struct CompiledWord {
+  std::string text;
+  char        quote { 0 };
+};
+
+// kind is "write", "append" or "read", matching ExecNode::redirects
+struct CompiledRedirect {
+  std::string  kind;
+  CompiledWord target;
+};
+
+struct CompiledCommand {
+  std::vector<CompiledWord>     words;
+  std::vector<CompiledRedirect> redirects;
+};
+
+// One line of a script: a pipeline, or the error to report when it is reached
+struct CompiledLine {
+  size_t                       lineNo { 0 };
+  std::vector<CompiledCommand> pipeline;
+  std::string                  error;
+};
+
+struct CompiledScript {
+  std::vector<CompiledLine> lines;
+};
+
+// Returns false with line.error set on a syntax error. Blank lines compile to an
+// empty pipeline.
+bool compile_line(const vec_tok &tokens, CompiledLine &line);
+CompiledScript compile(Lexer &lex);
+
+// Compact binary form for the script cache
+std::string encode_script(const CompiledScript &script);
+bool decode_script(std::string_view data, CompiledScript &script);
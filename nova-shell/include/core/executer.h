@@ -1,11 +1,17 @@
 #pragma once
 #include <unistd.h>   // for fork and execve
 #include <sys/wait.h> // for waitpid
+#include <fcntl.h>    // for open
+#include <spawn.h>    // for posix_spawn
 #include "core/lexer.h"
 #include "core/parser.h"
+#include "core/script_cache.h"
 #include "utils/env.h"
 #include "utils/path.h"
 
 #define DEBUG 1
 
 void execute(Lexer &lex, Env &env);
+void execute(const CompiledScript &script, Env &env);
+// Runs a script file, compiled once and cached on disk across runs
+int execute_file(const std::string &path, Env &env);
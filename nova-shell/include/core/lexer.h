@@ -6,8 +6,11 @@
 #include <fstream>
 #include <cstdlib>
 #include <cctype>
+#include <string_view>
+#include <vector>
 #include "utils/types.h"
 #include "utils/string.h"
+#include "core/source.h"
 
 
 struct Token;
@@ -15,9 +18,18 @@ using vec_tok = std::vector<Token>;
 enum class TokenType { OPERATOR, SEPARATOR, STRING };
 const vec_str TypeName { "OPERATOR", "SEPARATOR", "STRING" };
 
+// Where a token starts in the script, both 1-based
+struct Span {
+  size_t line   { 0 };
+  size_t column { 0 };
+};
+
+// value points into the Lexer's source, or its arena for quoted strings with escapes,
+// so tokens are only valid while the Lexer that made them is alive and unmoved
 struct Token {
-  TokenType type;
-  std::string value;
+  TokenType        type;
+  std::string_view value;
+  Span             span {};
 
   friend std::ostream& operator<<(std::ostream& s, const Token& t) {
     s << "[" << TypeName[(size_t)(t.type)] << " '" << t.value << "']\n";
@@ -26,20 +38,42 @@ struct Token {
 };
 
 
+// Bump allocator for token values that can't point into the source. Blocks never
+// move, so views into them stay valid until clear(), which keeps the first block.
+class StringArena {
+  static constexpr size_t BLOCK_SIZE { 4096 };
+
+  std::vector<std::unique_ptr<char[]>> blocks {};
+  size_t                               used   { 0 };
+  size_t                               last   { 0 }; // size of the newest block
+
+public:
+  char* allocate(size_t size);
+  void clear();
+};
+
+
 class Lexer {
-  std::string                   code        {};
-  size_t                        lineNo      {};
-  std::string                   file_path   {};
-  std::unique_ptr<std::istream> stream      {};
+  SourceBuffer source      {};
+  size_t       pos         { 0 };
+  size_t       lineNo      {};
+  std::string  file_path   {};
+  StringArena  arena       {};
+
+  void tokenize(std::string_view line, vec_tok &tokens);
 
 public:
   Lexer() {};
   Lexer(const std::string &code, bool fromFile);
+  // Lexes bytes that were already read, name is the file they came from
+  Lexer(SourceBuffer source, const std::string &name);
 
   static Lexer fromFile(const std::string &filepath);
   static Lexer fromString(const std::string &string);
 
+  // Tokens of the next line. They stay valid until the next call.
   vec_tok tokenize_line();
+  // Tokens of every remaining line, valid for the Lexer's lifetime
   vec_tok tokenize_all();
 
   bool eof();
@@ -4,12 +4,15 @@
 #include "utils/env.h"
 #include "utils/path.h"
 #include "core/ast.h"
+#include "core/compiler.h"
 #include <iostream>
 #include <algorithm>
-#include <regex>
 #include <memory>
 #include <unistd.h>
 
 
+// Lexed tokens straight to an AST, for interactive and -c input
 AST parse(const vec_tok &tokens, const Env &env);
+// Expands and resolves a compiled line against the current environment
+AST build_ast(const CompiledLine &line, const Env &env);
 bool is_builtin(const std::string &cmd);
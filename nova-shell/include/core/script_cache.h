@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "core/compiler.h"
+#include "utils/env.h"
+
+
+// Compiled scripts kept on disk under $XDG_CACHE_HOME/nova (or ~/.cache/nova), one
+// <hash of path>.nvc file per script. An entry is used when the script's size and
+// mtime match, or when only the mtime changed and the content hash still matches.
+// Anything unreadable is treated as a miss and rewritten.
+
+struct ScriptCacheStats {
+  uint64_t hits   { 0 };
+  uint64_t misses { 0 };
+};
+
+// Compiles the script at path or loads it from the cache. Returns false if the
+// script can't be read; a cache that can't be written only costs the next run.
+bool load_script(const std::string &path, const Env &env, CompiledScript &script, bool &hit);
+
+// Lookups made by this process, for debug output
+ScriptCacheStats script_cache_stats();
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+struct stat;
+
+// The bytes of a script. Regular files are mmap'd, so only the pages that are read
+// get loaded and nothing is copied; pipes, terminals and other unmappable inputs are
+// read() into an owned buffer instead. Lines are views into the buffer.
+class SourceBuffer {
+  const char  *mapped { nullptr };
+  size_t       length { 0 };
+  std::string  owned  {};
+
+  void release();
+
+public:
+  SourceBuffer() {}
+  explicit SourceBuffer(std::string text) : owned(std::move(text)) {}
+  ~SourceBuffer();
+
+  // move-only, the mapping has a single owner
+  SourceBuffer(SourceBuffer &&other) noexcept;
+  SourceBuffer& operator=(SourceBuffer &&other) noexcept;
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+  // Returns false with errno set if the file can't be opened or read. info, if given,
+  // gets the fstat of the descriptor the bytes came from.
+  bool open(const std::string &path, struct stat *info = nullptr);
+
+  std::string_view view() const {
+    return mapped ? std::string_view(mapped, length) : std::string_view(owned);
+  }
+  size_t size() const { return mapped ? length : owned.size(); }
+
+  // The line starting at pos, without its '\n'. pos moves past the newline.
+  std::string_view line(size_t &pos) const;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "utils/types.h"
+
+class Env;
+
+// Remembers where each command was found in $PATH, like bash's hash table, so a
+// command run again costs one stat of its directory instead of one per PATH entry.
+// An entry is checked against its directory's mtime when used: a command removed
+// or replaced there is searched for again. A new command earlier in PATH does not
+// shadow a hashed one until the table is cleared (`hash -r`) or PATH changes.
+class CommandHash {
+public:
+  struct Entry {
+    std::string path {};
+    size_t dir       { 0 };  // index into the expanded PATH directories
+    int64_t mtime    { 0 };  // of that directory when the command was found
+    unsigned hits    { 0 };
+  };
+
+  // Absolute path of program, empty if no PATH directory has it
+  std::string lookup(const std::string &program, const Env &env);
+
+  // Hashes program without counting it as used, false if it isn't in PATH
+  bool add(const std::string &program, const Env &env);
+
+  // Forgets every command and the expanded PATH, for when PATH changes
+  void clear();
+
+  // The table as `hash` prints it, most recently added last
+  std::string format() const;
+
+private:
+  void load_dirs(const Env &env);
+  // Full PATH search, fills entry on success
+  bool search(const std::string &program, Entry &entry) const;
+
+  bool loaded { false };
+  vec_str dirs {};
+  std::unordered_map<std::string, Entry> table {};
+  vec_str order {};
+};
@@ -1,19 +1,34 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <iostream>
-#include <cstring>   // for strdup
+#include <cstring>
 #include "utils/types.h"
 #include "utils/path.h"
 #include "utils/string.h"
+#include "utils/command_hash.h"
 
 class Env {
 private:
   umap_str vars {};
+  // Lookups are const for callers, the hash only remembers their results
+  mutable CommandHash commands {};
+
+  // Bumped by every set/unset; the envp block is rebuilt only when it is stale
+  uint64_t generation { 0 };
+  mutable uint64_t envp_generation { UINT64_MAX };
+  // Every "key=value\0" back to back, and the pointers into it execve wants
+  mutable std::string envp_block {};
+  mutable std::vector<char*> envp {};
 
 public:
   // Construct from char** envp
   Env(char **envp);
 
+  // A copy rebuilds its own envp block, the cached pointers point into the original's
+  Env(const Env &other);
+  Env& operator=(const Env &other);
+
   // Get value (returns empty string if not found)
   std::string get(const std::string &key) const;
 
@@ -26,9 +41,12 @@ public:
   // Print all environment variables
   void print() const;
 
-  // Export as char** for execve
-  std::vector<char*> to_envp() const;
+  // Export as a null terminated char** for execve, valid until the next set/unset
+  const std::vector<char*> &to_envp() const;
 
   // Get the absolute path of a program from the paths stored in $PATH
   std::string getFromPath(const std::string& program) const;
+
+  // Where getFromPath remembers its results, for the `hash` builtin
+  CommandHash &getCommandHash();
 };
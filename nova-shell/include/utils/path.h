@@ -1,6 +1,5 @@
 #pragma once
 #include <filesystem>
-#include <regex>
 #include <iostream>
 
 class Env;
@@ -0,0 +1,175 @@
+#include "core/compiler.h"
+
+
+bool compile_line(const vec_tok &tokens, CompiledLine &line) {
+  line.pipeline.clear();
+  line.error.clear();
+  if (tokens.empty()) return true;
+  line.lineNo = tokens[0].span.line;
+  line.pipeline.emplace_back();
+
+  for (size_t i = 0; i < tokens.size(); i++) {
+    const Token &tok = tokens[i];
+    auto &cmd = line.pipeline.back();
+
+    if (tok.type == TokenType::OPERATOR && tok.value == "|") {
+      if (cmd.words.empty()) {
+        line.error = "Nova: Expected a command before '|'";
+        return false;
+      }
+      line.pipeline.emplace_back();
+      continue;
+    }
+
+    if (tok.type == TokenType::OPERATOR && (tok.value == ">" || tok.value == ">>" || tok.value == "<")) {
+      if (++i >= tokens.size() || tokens[i].type != TokenType::STRING) {
+        line.error = "Nova: Expected a file after '" + std::string(tok.value) + "'";
+        return false;
+      }
+      const char *kind = tok.value == ">" ? "write" : tok.value == ">>" ? "append" : "read";
+      cmd.redirects.push_back({kind, {}});
+      std::string_view target = tokens[i].value;
+      char quote = (target[0] == '"' || target[0] == '\'') ? target[0] : 0;
+      if (quote) {
+        if (target.size() < 2 || target.back() != quote) {
+          line.error = "Nova: Unterminated string: " + std::string(target);
+          return false;
+        }
+        target = target.substr(1, target.size() - 2);
+      }
+      cmd.redirects.back().target = {std::string(target), quote};
+      continue;
+    }
+
+    // Everything else, other operators and separators included, is a word for now
+    std::string_view value = tok.value;
+    char quote = (tok.type == TokenType::STRING && (value[0] == '"' || value[0] == '\'')) ? value[0] : 0;
+    if (quote) {
+      if (value.size() < 2 || value.back() != quote) {
+        line.error = "Nova: Unterminated string: " + std::string(value);
+        return false;
+      }
+      value = value.substr(1, value.size() - 2);
+    }
+    cmd.words.push_back({std::string(value), quote});
+  }
+
+  if (line.pipeline.back().words.empty()) {
+    line.error = "Nova: Expected a command";
+    return false;
+  }
+  return true;
+}
+
+CompiledScript compile(Lexer &lex) {
+  CompiledScript script;
+  while (!lex.eof()) {
+    vec_tok tokens = lex.tokenize_line();
+    if (tokens.empty()) continue;
+    CompiledLine line;
+    compile_line(tokens, line);
+    script.lines.push_back(std::move(line));
+  }
+  return script;
+}
+
+
+// --- Binary form: LEB128 varints and length-prefixed strings ---
+static void putVarint(std::string &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((char)v);
+}
+
+static void putString(std::string &out, const std::string &s) {
+  putVarint(out, s.size());
+  out += s;
+}
+
+static void putWord(std::string &out, const CompiledWord &w) {
+  out.push_back(w.quote);
+  putString(out, w.text);
+}
+
+struct Reader {
+  std::string_view data;
+  size_t           pos { 0 };
+  bool             ok  { true };
+
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= data.size()) break;
+      uint8_t b = (uint8_t)data[pos++];
+      v |= (uint64_t)(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    ok = false;
+    return 0;
+  }
+
+  std::string string() {
+    uint64_t n = varint();
+    if (!ok || n > data.size() - pos) { ok = false; return {}; }
+    std::string s(data.substr(pos, n));
+    pos += n;
+    return s;
+  }
+
+  CompiledWord word() {
+    if (pos >= data.size()) { ok = false; return {}; }
+    char quote = data[pos++];
+    return {string(), quote};
+  }
+};
+
+std::string encode_script(const CompiledScript &script) {
+  std::string out;
+  putVarint(out, script.lines.size());
+  for (auto &line : script.lines) {
+    putVarint(out, line.lineNo);
+    putString(out, line.error);
+    putVarint(out, line.pipeline.size());
+    for (auto &cmd : line.pipeline) {
+      putVarint(out, cmd.words.size());
+      for (auto &w : cmd.words) putWord(out, w);
+      putVarint(out, cmd.redirects.size());
+      for (auto &r : cmd.redirects) {
+        putString(out, r.kind);
+        putWord(out, r.target);
+      }
+    }
+  }
+  return out;
+}
+
+bool decode_script(std::string_view data, CompiledScript &script) {
+  Reader in { data };
+  script.lines.clear();
+  // Every count is bounded by the bytes left, so corrupt input can't over-allocate
+  uint64_t lines = in.varint();
+  if (lines > data.size()) return false;
+  script.lines.resize(lines);
+  for (auto &line : script.lines) {
+    line.lineNo = in.varint();
+    line.error = in.string();
+    uint64_t cmds = in.varint();
+    if (!in.ok || cmds > data.size()) return false;
+    line.pipeline.resize(cmds);
+    for (auto &cmd : line.pipeline) {
+      uint64_t words = in.varint();
+      if (!in.ok || words > data.size()) return false;
+      for (uint64_t i = 0; i < words && in.ok; i++) cmd.words.push_back(in.word());
+      uint64_t redirects = in.varint();
+      if (!in.ok || redirects > data.size()) return false;
+      for (uint64_t i = 0; i < redirects && in.ok; i++) {
+        std::string kind = in.string();
+        cmd.redirects.push_back({kind, in.word()});
+      }
+    }
+    if (!in.ok) return false;
+  }
+  return in.ok && in.pos == data.size();
+}
@@ -1,15 +1,16 @@
 #include "core/executer.h"
 
 
+// Points into filename and args, which have to outlive the exec or spawn
 std::vector<char*> make_argv(const std::string &filename,
                              const vec_str &args) {
   std::vector<char*> argv;
   argv.reserve(args.size() + 2);
 
-  argv.push_back(strdup(filename.c_str()));   // copy program name
+  argv.push_back(const_cast<char*>(filename.c_str()));
 
   for (auto& arg : args) {
-    argv.push_back(strdup(arg.c_str()));  // copy each arg
+    argv.push_back(const_cast<char*>(arg.c_str()));
   }
   argv.push_back(nullptr);
 
@@ -45,6 +46,26 @@ void cmd_exit() {
   exit(0);
 }
 
+// hash: show the remembered command paths, -r forgets them, names are looked up and added
+int cmd_hash(const vec_str &args, Env &env) {
+  auto &table = env.getCommandHash();
+  if (args.empty()) {
+    auto out = table.format();
+    write(STDOUT_FILENO, out.c_str(), out.length());
+    return 0;
+  }
+
+  int status = 0;
+  for (auto &arg : args) {
+    if (arg == "-r") table.clear();
+    else if (!table.add(arg, env)) {
+      std::cerr << "hash: " << arg << ": not found\n";
+      status = 1;
+    }
+  }
+  return status;
+}
+
 int run_builtin(const std::string &cmd, const vec_str &args, Env &env) {
   if (cmd == "cd")
     return cmd_cd(args, env);
@@ -52,6 +73,8 @@ int run_builtin(const std::string &cmd, const vec_str &args, Env &env) {
     return cmd_pwd(env);
   else if (cmd == "exit")
     cmd_exit();
+  else if (cmd == "hash")
+    return cmd_hash(args, env);
 
   return -1;
 }
@@ -66,39 +89,98 @@ bool redirect_fd(const int &src, const int &target) {
   return true;
 }
 
+// Opens a redirect target for writing, appending or (input) reading, reporting failures
+int open_target(const std::string &path, bool append=false, bool input=false) {
+  int flags = input ? O_RDONLY : O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+  int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd < 0)
+    std::cerr << "Nova: couldn't open file: " << path << ": " << std::strerror(errno) << '\n';
+  return fd;
+}
+
 bool redirect_file(const std::string &path, int target, bool append=false, bool input=false) {
-  int flags = O_WRONLY | (append ? O_APPEND : O_CREAT | O_TRUNC);
-
-  int fd;
-  if (!input)
-    fd = open(path.c_str(), flags, 0644);
-  else
-    fd = open(path.c_str(), O_RDONLY);
-  if (fd < 0) {
-    std::cerr << "Nova: couldn't open file: " << path << '\n';
-    return false;
-  }
-  
+  int fd = open_target(path, append, input);
+  if (fd < 0) return false;
   return redirect_fd(fd, target);
 }
 
 
+// The parser already resolved the command, only a bare name still needs PATH
 std::string getFullCommand(const std::string& command, const Env& env) {
-  fs::path path { command };
-  if (!fs::exists(path) && !is_builtin(path))
-    path = env.getFromPath(path);
+  if (is_builtin(command) || command.find('/') != std::string::npos) return command;
 
-  if (!fs::exists(path) && !is_builtin(path)) {
-    std::cerr << "Nova: No command " << path << " Found, Did you mean:\n";
-    return {};
-  } return path;
+  auto path = env.getFromPath(command);
+  if (path.empty())
+    std::cerr << "Nova: No command " << command << " Found, Did you mean:\n";
+  return path;
+}
+
+void apply_redirects(const omap_str &redirects) {
+  for (const auto& [src, target] : redirects) {
+         if (src == "write")  redirect_file(target, STDOUT_FILENO);
+    else if (src == "append") redirect_file(target, STDOUT_FILENO, true);
+    else if (src == "read")   redirect_file(target, STDIN_FILENO, false, true);
+    else redirect_fd(stoi(src), stoi(target));
+  }
+}
+
+// Starts an external command with stdin/stdout taken from in/out (-1 keeps the
+// shell's) and its redirects applied, wired up as spawn file actions. glibc spawns with
+// clone(CLONE_VM | CLONE_VFORK), so unlike fork the cost doesn't grow with the
+// shell's heap. Returns -1 if the command couldn't be started.
+pid_t spawn_command(const std::string &command, const vec_str &args, const omap_str &redirects,
+                    int in, int out, char *const *envp) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  // Pipe ends are close-on-exec, only these copies reach the command
+  if (in != -1)  posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+  if (out != -1) posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+
+  // After the pipes so an explicit redirect wins. Targets are opened here rather than as
+  // spawn actions, so a failure names the file and the command doesn't run.
+  std::vector<int> opened;
+  for (const auto& [src, target] : redirects) {
+    int fd = -1, to = -1;
+         if (src == "write")  { fd = open_target(target);              to = STDOUT_FILENO; }
+    else if (src == "append") { fd = open_target(target, true);        to = STDOUT_FILENO; }
+    else if (src == "read")   { fd = open_target(target, false, true); to = STDIN_FILENO; }
+    else {
+      int from = stoi(src);
+      posix_spawn_file_actions_adddup2(&actions, from, stoi(target));
+      posix_spawn_file_actions_addclose(&actions, from);
+      continue;
+    }
+    if (fd < 0) {
+      for (int o : opened) close(o);
+      posix_spawn_file_actions_destroy(&actions);
+      return -1;
+    }
+    posix_spawn_file_actions_adddup2(&actions, fd, to);
+    opened.push_back(fd);
+  }
+
+  auto argv = make_argv(command, args);
+  pid_t pid;
+  int err = posix_spawn(&pid, command.c_str(), &actions, nullptr, argv.data(), envp);
+  posix_spawn_file_actions_destroy(&actions);
+  for (int fd : opened) close(fd);
+  if (err != 0) {
+    std::cerr << "Nova: couldn't run command: " << command << ": " << std::strerror(err) << '\n';
+    return -1;
+  }
+  return pid;
 }
 
 int run_command(ExecNode &node, Env &env) {
   bool isBasic = !node.pipe;
-  std::vector<int> pipes;
+  // Read end of the pipe feeding the next command, -1 for the first one
+  int prevRead = -1;
+  // Built in the parent, so it stays cached for the next command
+  char *const *envp = env.to_envp().data();
 
   std::vector<pid_t> pids {};
+  // Whether the last command of the pipeline started at all
+  bool lastStarted = false;
 
   ExecNode cmdNode = std::move(node);
   for (size_t i = 0; ; i++) {
@@ -109,8 +191,8 @@ int run_command(ExecNode &node, Env &env) {
 
     if (DEBUG) {
       std::clog << "Running: " << command << " ";
-      for (const auto& arg : args) std::cout << arg << ' ';
-      std::cout << '\n';
+      for (const auto& arg : args) std::clog << arg << ' ';
+      std::clog << '\n';
     }
 
 
@@ -118,47 +200,40 @@ int run_command(ExecNode &node, Env &env) {
     if (builtin && isBasic)
       return run_builtin(command, args, env);
 
-    pid_t pid = fork();
-    if (pid == 0) {
-      // --- CHILD ---
-
-      // Setup redirections
-      for (const auto& [src, target] : cmdNode.redirects) {
-             if (src == "write")  redirect_file(target, STDOUT_FILENO);
-        else if (src == "append") redirect_file(target, STDOUT_FILENO, true);
-        else if (src == "read")   redirect_file(target, STDIN_FILENO, false, true);
-        else redirect_fd(stoi(src), stoi(target));
-      }
-
-      if (cmdNode.pipe) {
-        pipes.push_back(0); pipes.push_back(0);
-        if (pipe(&pipes[i * 2]) == -1) {
-          std::cerr << "Nova: couldn't create a pipe" << '\n';
-          return 127;
-        }
-        if (i > 0) dup2(pipes[(i - 1) * 2], STDIN_FILENO);
-        if (cmdNode.pipe) dup2(pipes[i * 2 + 1], STDOUT_FILENO);
-      }
-      for (int fd : pipes) close(fd);
-
-      if (builtin)
-        return run_builtin(command, args, env);
-      else {
-        auto argv = make_argv(command, args);
-        execve(argv[0], argv.data(), env.to_envp().data());
-        std::cerr << "Nova: couldn't execv command: " << command << '\n';
-        return 127;
-      }
+    // The pipe has to exist before the command starts so both sides of it share it
+    int fds[2] = {-1, -1};
+    if (cmdNode.pipe && pipe2(fds, O_CLOEXEC) == -1) {
+      std::cerr << "Nova: couldn't create a pipe" << '\n';
+      if (prevRead != -1) close(prevRead);
+      lastStarted = false;
+      break;
+    }
+
+    // Anything the shell buffered comes before the command's output
+    std::cout.flush();
+    pid_t pid;
+    if (!builtin) pid = spawn_command(command, args, cmdNode.redirects, prevRead, fds[1], envp);
+    else if ((pid = fork()) == 0) {
+      // --- CHILD --- a builtin in a pipeline runs in a subshell
+      if (prevRead != -1) dup2(prevRead, STDIN_FILENO);
+      if (fds[1] != -1) dup2(fds[1], STDOUT_FILENO);
+      apply_redirects(cmdNode.redirects);
+      _exit(run_builtin(command, args, env));
     }
-    pids.push_back(pid);
-    if (cmdNode.pipe)
-      cmdNode = std::move(*static_cast<ExecNode*>(cmdNode.pipe.get()));
-    else break;
-  }
 
-  for (int fd : pipes) close(fd);
+    lastStarted = pid > 0;
+    if (pid > 0) pids.push_back(pid);
+    else if (pid < 0 && builtin) perror("fork failed");
+    if (prevRead != -1) close(prevRead);
+    if (fds[1] != -1) close(fds[1]);
+    prevRead = fds[0];
+    if (!cmdNode.pipe) break;
+    // Hold the next node while moving out of it, assigning pipe would free it half way
+    auto next = std::move(cmdNode.pipe);
+    cmdNode = std::move(*static_cast<ExecNode*>(next.get()));
+  }
 
-  int status;
+  int status = 0;
   for (pid_t pid : pids) {
     if (waitpid(pid, &status, 0) < 0) {
       perror("waitpid failed");
@@ -166,6 +241,7 @@ int run_command(ExecNode &node, Env &env) {
     }
   }
 
+  if (!lastStarted) return 127;
   if (WIFEXITED(status)) {
     return WEXITSTATUS(status);  // last child exit code
   } else {
@@ -201,3 +277,26 @@ void execute(Lexer &lex, Env &env) {
   }
 }
 
+void execute(const CompiledScript &script, Env &env) {
+  Interpreter intp(env);
+  for (auto &line : script.lines) {
+    auto ast = build_ast(line, env);
+    ast.traverse(intp);
+  }
+}
+
+int execute_file(const std::string &path, Env &env) {
+  CompiledScript script;
+  bool hit = false;
+  if (!load_script(path, env, script, hit)) {
+    std::cerr << "Error: Failed to open file for reading: " << path << ": " << std::strerror(errno) << '\n';
+    return 1;
+  }
+  if (DEBUG) {
+    auto stats = script_cache_stats();
+    std::clog << "Script cache " << (hit ? "hit" : "miss") << " for " << path << " ("
+              << stats.hits << " hits, " << stats.misses << " misses)\n";
+  }
+  execute(script, env);
+  return 0;
+}
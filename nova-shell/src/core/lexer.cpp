@@ -1,126 +1,173 @@
 #include "core/lexer.h"
 #include "utils/path.h"
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+
+// --- Character classes ---
+// Every byte is classified with one table lookup. Operators are at most two characters,
+// so the operator "trie" is the first character's class plus its list of valid seconds.
+enum CharClass : uint8_t {
+  WORD      = 0,
+  SPACE     = 1 << 0,
+  OPERATOR  = 1 << 1,
+  SEPARATOR = 1 << 2,
+  QUOTE     = 1 << 3,
+  // Anything that ends a bareword
+  BREAK     = SPACE | OPERATOR | SEPARATOR | QUOTE,
+};
 
+static constexpr std::array<uint8_t, 256> CHAR_CLASS = [] {
+  std::array<uint8_t, 256> table {};
+  for (unsigned char c : std::string_view(" \t\n\v\f\r")) table[c] = SPACE;
+  for (unsigned char c : std::string_view("=!|&<>"))       table[c] = OPERATOR;
+  for (unsigned char c : std::string_view("(){}[];"))      table[c] = SEPARATOR;
+  for (unsigned char c : std::string_view("\"'"))          table[c] = QUOTE;
+  return table;
+}();
 
-// --- Operator list & Match function ---
-static const vec_str OPERATORS = {
-    "==", "!=", "||", "&&", "!", "|", "&", "=", "<", ">", ">>", "<=", ">="
-};
-static vec_str sortedOperators = [] {
-    auto ops = OPERATORS;
-    std::sort(ops.begin(), ops.end(),
-              [](const std::string &a, const std::string &b) {
-                  return a.size() > b.size();
-              });
-    return ops;
+// Second characters that extend an operator: == != || && <= >> >=
+static constexpr std::array<const char*, 256> OPERATOR_SECOND = [] {
+  std::array<const char*, 256> table {};
+  table['='] = "=";
+  table['!'] = "=";
+  table['|'] = "|";
+  table['&'] = "&";
+  table['<'] = "=";
+  table['>'] = ">=";
+  return table;
 }();
-std::string matchOperator(const std::string &input, size_t pos) {
-    for (const auto &op : sortedOperators) {
-        if (input.compare(pos, op.size(), op) == 0) {
-            return op;
-        }
-    }
-    return {};
+
+static inline uint8_t charClass(char c) {
+  return CHAR_CLASS[static_cast<unsigned char>(c)];
 }
 
-// --- Separators ---
-static const std::string SEPARATORS = "(){}[];";
+// Length of the operator at pos, 0 if there is none
+static size_t operatorLength(std::string_view input, size_t pos) {
+  if (!(charClass(input[pos]) & OPERATOR)) return 0;
+  const char *second = OPERATOR_SECOND[static_cast<unsigned char>(input[pos])];
+  if (second && pos + 1 < input.size() && input[pos + 1] && std::strchr(second, input[pos + 1])) return 2;
+  return 1;
+}
+
+// --- Arena ---
+char* StringArena::allocate(size_t size) {
+  if (blocks.empty() || used + size > last) {
+    last = std::max(BLOCK_SIZE, size);
+    blocks.push_back(std::make_unique<char[]>(last));
+    used = 0;
+  }
+  char *out = blocks.back().get() + used;
+  used += size;
+  return out;
+}
+
+void StringArena::clear() {
+  if (blocks.size() > 1) {
+    blocks.erase(blocks.begin() + 1, blocks.end());
+    last = BLOCK_SIZE;
+  }
+  used = 0;
+}
 
 // --- Main tokenizer ---
-vec_tok tokenize(const std::string &input) {
-    vec_tok tokens;
+void Lexer::tokenize(std::string_view input, vec_tok &tokens) {
     size_t i = 0;
 
     while (i < input.size()) {
         char c = input[i];
+        uint8_t cls = charClass(c);
+        Span span { this->lineNo, i + 1 };
 
         // 1. Skip whitespace
-        if (std::isspace(static_cast<unsigned char>(c))) {
+        if (cls & SPACE) {
             i++;
             continue;
         }
 
         // 2. Operators
-        if (auto op = matchOperator(input, i); !op.empty()) {
-            tokens.push_back({TokenType::OPERATOR, op});
-            i += op.size();
+        if (cls & OPERATOR) {
+            size_t len = operatorLength(input, i);
+            tokens.push_back({TokenType::OPERATOR, input.substr(i, len), span});
+            i += len;
             continue;
         }
 
         // 3. Separators (single char)
-        if (SEPARATORS.find(c) != std::string::npos) {
-            tokens.push_back({TokenType::SEPARATOR, std::string(1, c)});
+        if (cls & SEPARATOR) {
+            tokens.push_back({TokenType::SEPARATOR, input.substr(i, 1), span});
             i++;
             continue;
         }
 
-        // 4. Quoted string
-        if (c == '"' || c == '\'') {
-            char quote = c;
-            i++; // size_t start = ++i; // skip starting quote
-            std::string value; value += quote;
-
-            while (i < input.size()) {
-                if (input[i] == '\\' && i + 1 < input.size()) {
-                    value.push_back(input[i + 1]); // unescape next char
-                    i += 2;
-                } else if (input[i] == quote) {
-                    i++;
-                    break;
-                } else {
-                    value.push_back(input[i++]);
+        // 4. Quoted string, quotes included. Without escapes it is a slice of the
+        //    line, otherwise the unescaped copy goes to the arena.
+        if (cls & QUOTE) {
+            size_t start = i++;
+            size_t escapes = 0;
+            while (i < input.size() && input[i] != c) {
+                if (input[i] == '\\' && i + 1 < input.size()) { escapes++; i++; }
+                i++;
+            }
+            if (i < input.size()) i++; // closing quote
+
+            std::string_view raw = input.substr(start, i - start);
+            if (escapes) {
+                char *out = this->arena.allocate(raw.size() - escapes);
+                size_t n = 0;
+                out[n++] = c;
+                for (size_t j = 1; j < raw.size(); j++) {
+                    if (raw[j] == '\\' && j + 1 < raw.size()) j++; // same rule as the scan above
+                    out[n++] = raw[j];
                 }
+                raw = std::string_view(out, n);
             }
-
-            tokens.push_back({TokenType::STRING, value});
+            tokens.push_back({TokenType::STRING, raw, span});
             continue;
         }
 
-        // 5. Bareword (collect until space/operator/separator/quote)
+        // 5. Bareword (collect until space/operator/separator/quote). A closed ${name}
+        //    or $(cmd) stays inside the word, expansion happens later on the whole of it.
         size_t start = i;
         while (i < input.size()) {
-            if (std::isspace(static_cast<unsigned char>(input[i]))) break;
-            if (!matchOperator(input, i).empty()) break;
-            if (SEPARATORS.find(input[i]) != std::string::npos) break;
-            if (input[i] == '"' || input[i] == '\'') break;
+            if (input[i] == '$' && i + 1 < input.size() && (input[i + 1] == '{' || input[i + 1] == '(')) {
+                size_t close = input.find(input[i + 1] == '{' ? '}' : ')', i + 2);
+                if (close != std::string_view::npos) {
+                    i = close + 1;
+                    continue;
+                }
+            }
+            if (charClass(input[i]) & BREAK) break;
             i++;
         }
-        tokens.push_back({TokenType::STRING, input.substr(start, i - start)});
+        tokens.push_back({TokenType::STRING, input.substr(start, i - start), span});
     }
-
-    return tokens;
 }
 
 
 Lexer::Lexer(const std::string &input, bool fromFile) {
-  this->code = "";
   this->lineNo = 0;
+  this->pos = 0;
 
   if (fromFile) {
     this->file_path = input;
-    std::ifstream ifs(input, std::ios::binary | std::ios::ate);
-    if (!ifs.is_open()) {
-      std::cerr << "Error: Failed to open file for reading: " << this->file_path << '\n';
+    if (!this->source.open(input)) {
+      std::cerr << "Error: Failed to open file for reading: " << this->file_path
+                << ": " << std::strerror(errno) << '\n';
       exit(1);
     }
-    auto size = ifs.tellg();
-    ifs.seekg(0, std::ios::beg);
-
-    std::string buffer(size, '\0');
-    ifs.read(buffer.data(), size);
-
-    this->stream = std::make_unique<std::istringstream>(buffer);
   } else {
     this->file_path = "stdin";
-    this->stream = std::make_unique<std::istringstream>(input);
-  }
-
-  if (!this->stream->good()) {
-    std::cerr << "Error: istringstream is not healthy\n";
-    exit(1);
+    this->source = SourceBuffer(input);
   }
 }
 
+Lexer::Lexer(SourceBuffer source, const std::string &name)
+  : source(std::move(source)), pos(0), lineNo(0), file_path(name) {}
+
 Lexer Lexer::fromFile(const std::string &filepath) {
   return Lexer(filepath, true);
 }
@@ -130,24 +177,25 @@ Lexer Lexer::fromString(const std::string &string) {
 }
 
 vec_tok Lexer::tokenize_line() {
+  vec_tok tokens {};
+  if (this->eof()) return tokens;
+
   this->lineNo++;
-  std::string line {};
-  std::getline(*this->stream, line);
-  return tokenize(line);
+  std::string_view line = this->source.line(this->pos);
+  this->arena.clear();
+  this->tokenize(line, tokens);
+  return tokens;
 }
 
 vec_tok Lexer::tokenize_all() {
   vec_tok tokens {};
-  while (!this->stream->eof()) {
+  while (!this->eof()) {
     this->lineNo++;
-    std::string line {};
-    std::getline(*this->stream, line);
-    auto next = tokenize(line);
-    tokens.insert(tokens.end(), next.begin(), next.end());
+    this->tokenize(this->source.line(this->pos), tokens);
   }
   return tokens;
 }
 
 bool Lexer::eof() {
-  return this->stream->eof();
+  return this->pos >= this->source.size();
 }
@@ -1,25 +1,10 @@
 #include "core/parser.h"
 
 
-const std::string builtins = "cd pwd exit";
+const set_str builtins { "cd", "pwd", "exit", "hash" };
 
 bool is_builtin(const std::string &cmd) {
-  if (builtins.find(cmd) == std::string::npos) return false;
-  return true;
-}
-
-bool valid_quotes(const vec_tok &tokens) {
-  for (auto &tok : tokens) {
-    auto value = tok.value;
-    if (
-      (value[0] == '\'' && value[value.length()-1] != '\'')
-      || (value[0] == '"' && value[value.length()-1] != '"')
-    ) {
-      std::cerr << "Nova: Unterminated string: " << value << '\n';
-      return false;
-    }
-  }
-  return true;
+  return builtins.count(cmd) > 0;
 }
 
 bool addValidCmd(
@@ -28,12 +13,21 @@ bool addValidCmd(
   const Env &env,
   ExecNode *node
 ) {
-  std::string path = utils::parse_path(cmd, env);
-  if (!fs::exists(path) && !is_builtin(path))
+  // Only a name with a slash in it is a path, anything else is a builtin or looked up in PATH
+  std::string path = cmd;
+  if (cmd.find_first_of("/$~") != std::string::npos)
+    path = utils::parse_path(cmd, env).string();
+
+  bool found;
+  if (is_builtin(path)) found = true;
+  else if (path.find('/') != std::string::npos) found = fs::exists(path);
+  else {
     path = env.getFromPath(path);
+    found = !path.empty();
+  }
 
-  if (!fs::exists(path) && !is_builtin(path)) {
-    std::cerr << "Nova: No command " << path << " Found, Did you mean:\n";
+  if (!found) {
+    std::cerr << "Nova: No command " << cmd << " Found, Did you mean:\n";
     return false;
   } else {
     if (1) std::cout << "Adding command: " << path << '\n';
@@ -43,89 +37,47 @@ bool addValidCmd(
   }
 }
 
-bool handleRedirects(
-  const std::string op,
-  const vec_tok &tokens,
-  size_t &i,
-  const Env &env,
-  ExecNode* node
-) {
-  if (++i >= tokens.size()) {
-    std::cerr << "Nova: Unexpected end of tokens\n";
-    return false;
-  }
-
-  if (op == ">") {
-    node->redirects.emplace("write", utils::parse_path(tokens[i].value, env));
-  }
-  else if (op == ">>") {
-    node->redirects.emplace("append", utils::parse_path(tokens[i].value, env));
-  }
-  else if (op == "<") {
-    node->redirects.emplace("read", utils::parse_path(tokens[i].value, env));
-  }
-  else return false;
-
-  i++;
-  return true;
+// Expands a word the way it was quoted: single quotes keep it literal, anything
+// else goes through variable, substitution and path expansion
+std::string expand_word(const CompiledWord &word, const Env &env) {
+  if (word.quote == '\'') return word.text;
+  return utils::parse_path(word.text, env).string();
 }
 
-std::unique_ptr<ExecNode> parse_command(
-  const vec_tok &tokens,
-  size_t &idx,
-  const Env &env
-) {
+std::unique_ptr<ExecNode> build_command(const CompiledCommand &cmd, const Env &env) {
   auto node = std::make_unique<ExecNode>();
-  std::string cmd { tokens[0].value };
   vec_str args {};
+  args.reserve(cmd.words.size() - 1);
+  for (size_t i = 1; i < cmd.words.size(); i++) args.push_back(expand_word(cmd.words[i], env));
+  if (!addValidCmd(cmd.words[0].text, args, env, node.get())) return nullptr;
 
-  std::string redOps(" > >> < ");
-
-  for (; idx<tokens.size(); idx++) {
-    auto type = tokens[idx].type;
-    auto value = tokens[idx].value;
-    auto isRed = redOps.find(' ' + value + ' ') != std::string::npos;
-
-    if (type == TokenType::OPERATOR) {
-      if (!addValidCmd(cmd, args, env, node.get())) return nullptr;
-      if (isRed && !handleRedirects(value, tokens, idx, env, node.get())) return nullptr;
-      if (value == "|") {
-        std::unique_ptr<ExecNode> next;
-        if (!(next = parse_command(tokens, ++idx, env))) return nullptr;
-        node->pipe = std::move(next);
-      }
-    } else if (value[0] != '\'') {
-      if (value[0] == '"') value = value.substr(1, value.length()-2);
-      value = utils::parse_path(value, env);
-    }
-
-    if (value[0] == '\'') value = value.substr(1, value.length()-2);
-    args.push_back(value);
-  }
-  // if (!cmd.empty() && addValidCmd(cmd, args, env, node.get())) return nullptr;
+  for (auto &red : cmd.redirects)
+    node->redirects.emplace(red.kind, utils::parse_path(red.target.text, env).string());
   return node;
 }
 
-AST parse(const vec_tok &tokens, const Env &env) {
-  if (!tokens.size() || !valid_quotes(tokens)) {
+AST build_ast(const CompiledLine &line, const Env &env) {
+  if (!line.error.empty()) {
+    std::cerr << line.error << '\n';
     return {};
   }
+  if (line.pipeline.empty()) return {};
 
   AST ast;
-  size_t idx = 0;
-  // TokenType type = { tokens[0].type };
-  // std::string value { tokens[0].value };
-  if (0) { // TODO: Keyword check
-
+  // Build from the end so each command can take ownership of the one it pipes into
+  std::unique_ptr<ExecNode> next;
+  for (size_t i = line.pipeline.size(); i-- > 0;) {
+    auto node = build_command(line.pipeline[i], env);
+    if (!node) return {};
+    node->pipe = std::move(next);
+    next = std::move(node);
   }
-  else if (0) { // TODO: Assignment check
-
-  }
-  else{
-    std::unique_ptr<ExecNode> cmdNode;
-    if (!(cmdNode = parse_command(tokens, idx, env))) return {};
-    ast.append_node(std::move(cmdNode));
-  }
-
+  ast.append_node(std::move(next));
   return ast;
 }
+
+AST parse(const vec_tok &tokens, const Env &env) {
+  CompiledLine line;
+  compile_line(tokens, line);
+  return build_ast(line, env);
+}
@@ -0,0 +1,113 @@
+#include "core/script_cache.h"
+#include "core/source.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// The last byte is the format version, bumped whenever lexing or compiling a script changes
+static const char MAGIC[4] = {'N', 'V', 'C', '2'};
+
+static uint64_t fnv1a(std::string_view data) {
+  uint64_t h = 1469598103934665603ULL;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static fs::path cache_dir(const Env &env) {
+  std::string base = env.get("XDG_CACHE_HOME");
+  if (base.empty()) base = env.get("HOME") + "/.cache";
+  return fs::path(base) / "nova";
+}
+
+// Header: magic, then script size, mtime in ns and content hash as fixed 8-byte fields
+struct Header {
+  uint64_t size  { 0 };
+  uint64_t mtime { 0 };
+  uint64_t hash  { 0 };
+};
+static const size_t HEADER_SIZE = sizeof(MAGIC) + 3 * sizeof(uint64_t);
+
+static bool read_header(std::string_view data, Header &h) {
+  if (data.size() < HEADER_SIZE || data.compare(0, sizeof(MAGIC), std::string_view(MAGIC, sizeof(MAGIC))) != 0)
+    return false;
+  const char *p = data.data() + sizeof(MAGIC);
+  std::copy(p, p + sizeof(uint64_t), reinterpret_cast<char*>(&h.size));
+  std::copy(p + 8, p + 8 + sizeof(uint64_t), reinterpret_cast<char*>(&h.mtime));
+  std::copy(p + 16, p + 16 + sizeof(uint64_t), reinterpret_cast<char*>(&h.hash));
+  return true;
+}
+
+static std::string make_header(const Header &h) {
+  std::string out(MAGIC, sizeof(MAGIC));
+  out.append(reinterpret_cast<const char*>(&h.size), sizeof(uint64_t));
+  out.append(reinterpret_cast<const char*>(&h.mtime), sizeof(uint64_t));
+  out.append(reinterpret_cast<const char*>(&h.hash), sizeof(uint64_t));
+  return out;
+}
+
+// Written to a temporary name and renamed, so a concurrent run never sees half a file
+static void write_entry(const fs::path &file, const std::string &data) {
+  std::error_code ec;
+  fs::create_directories(file.parent_path(), ec);
+  fs::path tmp = file;
+  tmp += "." + std::to_string(getpid());
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.write(data.data(), data.size())) return;
+  }
+  fs::rename(tmp, file, ec);
+  if (ec) fs::remove(tmp, ec);
+}
+
+// Kept in memory only, nothing on the cached path should cost extra file I/O
+static ScriptCacheStats stats {};
+
+ScriptCacheStats script_cache_stats() {
+  return stats;
+}
+
+bool load_script(const std::string &path, const Env &env, CompiledScript &script, bool &hit) {
+  hit = false;
+  // Size, mtime, hash and the compiled code all come from this one read, so they agree
+  // even if the file changes meanwhile, and a pipe is only drained once
+  SourceBuffer source;
+  struct stat st;
+  if (!source.open(path, &st)) return false;
+
+  Header now { (uint64_t)source.size(), (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec, 0 };
+  std::error_code ec;
+  fs::path absolute = fs::absolute(path, ec);
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.nvc", (unsigned long long)fnv1a(absolute.string()));
+  fs::path entry = cache_dir(env) / name;
+
+  // Only regular files have a stable identity worth caching
+  bool cacheable = S_ISREG(st.st_mode);
+  SourceBuffer cached;
+  Header old;
+  if (cacheable && cached.open(entry.string()) && read_header(cached.view(), old) && old.size == now.size) {
+    std::string_view payload = cached.view().substr(HEADER_SIZE);
+    if (old.mtime == now.mtime) {
+      hit = decode_script(payload, script);
+    } else if ((now.hash = fnv1a(source.view())) == old.hash) {
+      // Touched but unchanged: keep the entry, with the new mtime
+      hit = decode_script(payload, script);
+      if (hit) write_entry(entry, make_header(now) + std::string(payload));
+    }
+  }
+
+  if (!hit) {
+    if (cacheable && !now.hash) now.hash = fnv1a(source.view());
+    Lexer lex(std::move(source), path);
+    script = compile(lex);
+    if (cacheable) write_entry(entry, make_header(now) + encode_script(script));
+  }
+  if (cacheable) (hit ? stats.hits : stats.misses)++;
+  return true;
+}
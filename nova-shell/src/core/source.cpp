@@ -0,0 +1,92 @@
+#include "core/source.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+SourceBuffer::~SourceBuffer() {
+  release();
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer &&other) noexcept
+  : mapped(other.mapped), length(other.length), owned(std::move(other.owned)) {
+  other.mapped = nullptr;
+  other.length = 0;
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer &&other) noexcept {
+  if (this != &other) {
+    release();
+    mapped = other.mapped;
+    length = other.length;
+    owned = std::move(other.owned);
+    other.mapped = nullptr;
+    other.length = 0;
+  }
+  return *this;
+}
+
+void SourceBuffer::release() {
+  if (mapped) munmap(const_cast<char*>(mapped), length);
+  mapped = nullptr;
+  length = 0;
+  owned.clear();
+}
+
+bool SourceBuffer::open(const std::string &path, struct stat *info) {
+  release();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  bool known = fstat(fd, &st) == 0;
+  if (info) {
+    if (!known) {
+      int err = errno;
+      close(fd);
+      errno = err;
+      return false;
+    }
+    *info = st;
+  }
+  if (known && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      mapped = static_cast<const char*>(p);
+      length = st.st_size;
+      close(fd);
+      return true;
+    }
+  }
+
+  // Pipes, stdin and anything else mmap refuses: read until EOF
+  char buf[65536];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      int err = errno;
+      close(fd);
+      owned.clear();
+      errno = err;
+      return false;
+    }
+    owned.append(buf, n);
+  }
+  close(fd);
+  return true;
+}
+
+std::string_view SourceBuffer::line(size_t &pos) const {
+  std::string_view text = view();
+  const char *start = text.data() + pos;
+  size_t left = text.size() - pos;
+  const char *nl = static_cast<const char*>(memchr(start, '\n', left));
+  size_t len = nl ? nl - start : left;
+  pos += len + 1;
+  return std::string_view(start, len);
+}
@@ -58,8 +58,7 @@ int main(int argc, char *argv[], char *envp[]) {
   } else
   if (argc == 2 && argv[1][0] != '-') {
     std::string file(argv[1]);
-    lex = Lexer::fromFile(file);
-    execute(lex, env);
+    return execute_file(file, env);
   }
   else {
     while (true) {
@@ -0,0 +1,105 @@
+#include "utils/command_hash.h"
+#include "utils/env.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+static bool dir_mtime(const std::string &dir, int64_t &mtime) {
+  struct stat st;
+  if (stat(dir.c_str(), &st) != 0) return false;
+  mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  return true;
+}
+
+static bool is_executable_file(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 0111);
+}
+
+void CommandHash::load_dirs(const Env &env) {
+  this->dirs.clear();
+  for (auto &dir : utils::split_string(env.get("PATH"), ":")) {
+    // An empty entry means the current directory, which is never worth hashing
+    if (dir.empty()) continue;
+    this->dirs.push_back(utils::parse_path(dir, env).string());
+  }
+  this->loaded = true;
+}
+
+bool CommandHash::search(const std::string &program, Entry &entry) const {
+  for (size_t i = 0; i < this->dirs.size(); i++) {
+    // Read the mtime first so a change racing with the check invalidates the entry
+    int64_t mtime;
+    if (!dir_mtime(this->dirs[i], mtime)) continue;
+    std::string path = this->dirs[i] + '/' + program;
+    if (!is_executable_file(path)) continue;
+    entry.path = std::move(path);
+    entry.dir = i;
+    entry.mtime = mtime;
+    return true;
+  }
+  return false;
+}
+
+std::string CommandHash::lookup(const std::string &program, const Env &env) {
+  if (!this->loaded) this->load_dirs(env);
+
+  auto it = this->table.find(program);
+  if (it != this->table.end()) {
+    int64_t mtime;
+    if (dir_mtime(this->dirs[it->second.dir], mtime) && mtime == it->second.mtime) {
+      it->second.hits++;
+      return it->second.path;
+    }
+    // Something in its directory changed, the command may have moved or gone
+    unsigned hits = it->second.hits;
+    if (!this->search(program, it->second)) {
+      this->table.erase(it);
+      this->order.erase(std::find(this->order.begin(), this->order.end(), program));
+      return "";
+    }
+    it->second.hits = hits + 1;
+    return it->second.path;
+  }
+
+  Entry entry;
+  if (!this->search(program, entry)) return "";
+  entry.hits = 1;
+  this->order.push_back(program);
+  return this->table.emplace(program, std::move(entry)).first->second.path;
+}
+
+bool CommandHash::add(const std::string &program, const Env &env) {
+  if (!this->loaded) this->load_dirs(env);
+
+  Entry entry;
+  if (!this->search(program, entry)) return false;
+  auto it = this->table.find(program);
+  if (it == this->table.end()) {
+    this->order.push_back(program);
+    this->table.emplace(program, std::move(entry));
+  } else {
+    entry.hits = it->second.hits;
+    it->second = std::move(entry);
+  }
+  return true;
+}
+
+void CommandHash::clear() {
+  this->loaded = false;
+  this->dirs.clear();
+  this->table.clear();
+  this->order.clear();
+}
+
+std::string CommandHash::format() const {
+  if (this->table.empty()) return "hash: hash table empty\n";
+
+  std::string out = "hits\tcommand\n";
+  for (auto &name : this->order) {
+    auto &entry = this->table.at(name);
+    std::string hits = std::to_string(entry.hits);
+    out.append(hits.size() < 4 ? 4 - hits.size() : 0, ' ');
+    out += hits + '\t' + entry.path + '\n';
+  }
+  return out;
+}
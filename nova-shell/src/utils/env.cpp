@@ -10,17 +10,41 @@ Env::Env(char **envp) {
     }
 }
 
+Env::Env(const Env &other)
+    : vars(other.vars), commands(other.commands), generation(other.generation) {}
+
+Env& Env::operator=(const Env &other) {
+    if (this != &other) {
+        this->vars = other.vars;
+        this->commands = other.commands;
+        this->generation = other.generation;
+        this->envp_generation = UINT64_MAX;
+        this->envp_block.clear();
+        this->envp.clear();
+    }
+    return *this;
+}
+
 std::string Env::get(const std::string &key) const {
     auto it = this->vars.find(key);
     return (it != this->vars.end()) ? it->second : "";
 }
 
+// PATH entries may start with ~, so a new HOME moves them as well
+static bool affects_path(const std::string &key) {
+    return key == "PATH" || key == "HOME";
+}
+
 void Env::set(const std::string &key, const std::string &value) {
     this->vars[key] = value;
+    this->generation++;
+    if (affects_path(key)) this->commands.clear();
 }
 
 void Env::unset(const std::string &key) {
     this->vars.erase(key);
+    this->generation++;
+    if (affects_path(key)) this->commands.clear();
 }
 
 void Env::print() const {
@@ -29,28 +53,36 @@ void Env::print() const {
     }
 }
 
-std::vector<char*> Env::to_envp() const {
-    std::vector<char*> envp;
-    envp.reserve(this->vars.size() + 1);
+const std::vector<char*> &Env::to_envp() const {
+    if (this->envp_generation == this->generation) return this->envp;
+
+    size_t bytes = 0;
+    for (auto &kv : this->vars) bytes += kv.first.size() + kv.second.size() + 2;
 
+    // Filled completely before taking pointers, so the block never moves under them
+    this->envp_block.clear();
+    this->envp_block.reserve(bytes);
     for (auto &kv : this->vars) {
-        std::string entry = kv.first + "=" + kv.second;
-        char *cstr = strdup(entry.c_str()); // required for execve
-        envp.push_back(cstr);
+        this->envp_block += kv.first;
+        this->envp_block += '=';
+        this->envp_block += kv.second;
+        this->envp_block += '\0';
     }
 
-    envp.push_back(nullptr);
-    return envp;
+    this->envp.clear();
+    this->envp.reserve(this->vars.size() + 1);
+    for (size_t pos = 0; pos < this->envp_block.size(); pos = this->envp_block.find('\0', pos) + 1)
+        this->envp.push_back(&this->envp_block[pos]);
+    this->envp.push_back(nullptr);
+
+    this->envp_generation = this->generation;
+    return this->envp;
 }
 
 std::string Env::getFromPath(const std::string &program) const {
-  auto path_var = this->get("PATH");
-  auto paths = utils::split_string(path_var, ":");
-
-  for (auto& path : paths) {
-    fs::path p = utils::parse_path(path, *this) / program;
-    if (fs::exists(p)) return p.string();
-  }
+  return this->commands.lookup(program, *this);
+}
 
-  return "";
+CommandHash &Env::getCommandHash() {
+  return this->commands;
 }
@@ -1,65 +1,93 @@
 #include "utils/path.h"
 #include "utils/env.h"
+#include <cstring>
+#include <string_view>
 
-std::string replaceWithEnv(const std::string &input, const Env &env) {
-  using namespace std;
+static bool is_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
 
-  regex envPattern(R"(\$(\w+))");
-  string result {};
-  auto begin = sregex_iterator(input.begin(), input.end(), envPattern);
-  auto end   = sregex_iterator();
+// Appends input to out with $name and ${name} replaced by their values. A $ that
+// doesn't start one of them is kept as it is.
+static void expand_vars(std::string_view input, const Env &env, std::string &out) {
+  const char *p = input.data();
+  const char *end = p + input.size();
+  std::string name;
 
-  size_t lastPos { 0 };
-  for (auto it = begin; it != end; ++it) {
-    smatch m { *it };
-    // append everything before match
-    result.append(input, lastPos, m.position() - lastPos);
-    // append replacement
-    result += env.get(m.str(1));
-    // move past this match
-    lastPos = m.position() + m.length();
-  }
-  // append the rest of the string
-  result.append(input, lastPos, string::npos);
+  while (p < end) {
+    auto dollar = static_cast<const char*>(std::memchr(p, '$', end - p));
+    if (!dollar) break;
+    out.append(p, dollar);
+    p = dollar + 1;
+
+    const char *start = p;
+    bool braced = p < end && *p == '{';
+    if (braced) start = ++p;
+    while (p < end && is_name_char(*p)) p++;
 
-  return result;
+    if (p == start || (braced && (p == end || *p != '}'))) {
+      // Not a variable after all, keep the text and carry on after the $
+      out += '$';
+      p = dollar + 1;
+      continue;
+    }
+    name.assign(start, p);
+    out += env.get(name);
+    if (braced) p++;
+  }
+  out.append(p, end);
 }
 
-std::string replaceWithRun(const std::string &input) {
-  using namespace std;
+// One pass over input: $(cmd) becomes run("cmd") (with the variables in cmd
+// expanded), then $name and ${name} take their values
+static void expand(std::string_view input, const Env &env, std::string &out) {
+  // Text from p on hasn't been written yet, scan is where to look for the next $
+  const char *p = input.data();
+  const char *end = p + input.size();
+  const char *scan = p;
 
-  regex runPattern(R"(\$\(([^)]+)\))");
-  string result {};
-  auto begin = sregex_iterator(input.begin(), input.end(), runPattern);
-  auto end   = sregex_iterator();
+  while (scan < end) {
+    auto dollar = static_cast<const char*>(std::memchr(scan, '$', end - scan));
+    if (!dollar) break;
 
-  size_t lastPos { 0 };
-  for (auto it = begin; it != end; ++it) {
-    smatch m { *it };
-    result.append(input, lastPos, m.position() - lastPos);
-    result += "run(\"" + m.str(1) + "\")";
-    lastPos = m.position() + m.length();
-  }
-  result.append(input, lastPos, string::npos);
+    const char *close = nullptr;
+    if (dollar + 1 < end && dollar[1] == '(')
+      close = static_cast<const char*>(std::memchr(dollar + 2, ')', end - dollar - 2));
+    // An empty $() isn't a substitution, any variable here is expanded with the text around it
+    if (!close || close == dollar + 2) {
+      scan = dollar + 1;
+      continue;
+    }
 
-  return result;
+    expand_vars({ p, size_t(dollar - p) }, env, out);
+    out += "run(\"";
+    expand_vars({ dollar + 2, size_t(close - dollar - 2) }, env, out);
+    out += "\")";
+    p = scan = close + 1;
+  }
+  expand_vars({ p, size_t(end - p) }, env, out);
 }
 
 fs::path utils::parse_path(const fs::path &input, const Env &env) {
-  std::string result { replaceWithRun(input.string()) };
-  result = replaceWithEnv(result, env);
+  // Reused across calls, so expansion allocates only when a word outgrows it
+  static thread_local std::string buffer;
+  const std::string &native = input.native();
+  buffer.clear();
+  if (std::memchr(native.data(), '$', native.size())) expand(native, env, buffer);
+  else buffer = native;
 
-  std::string path_str { result };
+  const std::string &path_str { buffer };
   fs::path path = { path_str };
   auto pre = path.string().substr(0, 2);
 
   // Replace '~' and relative paths
   if (path_str[0] == '~') path = env.get("HOME") + '/' + path_str.substr(1); else
   if (path.is_relative()) {
-    auto resolved = path.string();
-    if (pre == "./" || pre == "../")
-      resolved = parse_path(env.get("PWD") / path, env);
-    if (fs::exists(resolved)) path = resolved;
+    // Already expanded, so only made absolute; other relative words are left alone
+    if (pre == "./" || pre == "../") {
+      auto resolved = fs::path(env.get("PWD")) / path;
+      if (fs::exists(resolved)) path = resolved;
+    }
   }
 
   path = path.lexically_normal().string();